@@ -0,0 +1,109 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "model.h"
+#include "thread_pool.h"
+
+// Loads models in the background. OBJ parsing, mesh optimization and image
+// decoding run on the thread pool (one job per model plus one per texture);
+// finished models queue up until the main thread calls pump(), which does
+// the GL upload and hands each Model to its callback.
+class AssetLoader {
+public:
+    using ModelCallback = std::function<void(std::unique_ptr<Model>)>;
+
+    AssetLoader(unsigned int threadCount = 0) : pool(threadCount) {
+    }
+
+    void loadModel(const std::string& path, ModelCallback onLoaded) {
+        auto job = std::make_shared<Job>();
+        job->path = path;
+        job->onLoaded = std::move(onLoaded);
+        inFlight++;
+
+        pool.submit([this, job] {
+            try {
+                job->data = Model::loadGeometry(job->path);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "ERR: " << e.what() << std::endl;
+                job->failed = true;
+                finish(job);
+                return;
+            }
+
+            job->remaining = static_cast<int>(job->data.images.size()) + 1;
+            for (size_t i = 0; i < job->data.images.size(); i++) {
+                pool.submit([this, job, i] {
+                    TextureManager::decodeImage(job->data.images[i]);
+                    if (--job->remaining == 0)
+                        finish(job);
+                });
+            }
+            if (--job->remaining == 0)
+                finish(job);
+        });
+    }
+
+    // Uploads finished models until the time budget is spent; at least one
+    // model is uploaded per call so loading always makes progress.
+    void pump(double budgetMs = 4.0) {
+        auto start = std::chrono::steady_clock::now();
+        for (;;) {
+            std::shared_ptr<Job> job;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (finished.empty())
+                    return;
+                job = finished.front();
+                finished.erase(finished.begin());
+            }
+
+            if (!job->failed)
+                job->onLoaded(std::make_unique<Model>(std::move(job->data)));
+            inFlight--;
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= budgetMs)
+                return;
+        }
+    }
+
+    bool idle() const {
+        return inFlight == 0;
+    }
+
+    unsigned int workerCount() const {
+        return pool.size();
+    }
+
+private:
+    struct Job {
+        std::string path;
+        ModelCallback onLoaded;
+        ModelData data;
+        std::atomic<int> remaining{ 0 };
+        bool failed = false;
+    };
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Job>> finished;
+    std::atomic<int> inFlight{ 0 };
+    ThreadPool pool;
+
+    void finish(const std::shared_ptr<Job>& job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(job);
+    }
+};
+
+#endif
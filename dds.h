@@ -0,0 +1,153 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Minimal DDS container support for block-compressed textures with a
+// precomputed mip chain: DXT1 (BC1) and DXT5 (BC3) only, no cube maps,
+// arrays or DX10 extension header. Shared by the runtime loader and the
+// offline converter in tools/.
+namespace dds {
+
+const uint32_t MAGIC = 0x20534444;   // "DDS "
+const uint32_t FOURCC_DXT1 = 0x31545844;
+const uint32_t FOURCC_DXT5 = 0x35545844;
+
+const uint32_t DDSD_CAPS = 0x1;
+const uint32_t DDSD_HEIGHT = 0x2;
+const uint32_t DDSD_WIDTH = 0x4;
+const uint32_t DDSD_PIXELFORMAT = 0x1000;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const uint32_t DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8;
+const uint32_t DDSCAPS_TEXTURE = 0x1000;
+const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+struct PixelFormat {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rBitMask;
+    uint32_t gBitMask;
+    uint32_t bBitMask;
+    uint32_t aBitMask;
+};
+
+struct Header {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    PixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+struct Level {
+    uint32_t width;
+    uint32_t height;
+    size_t offset;
+    size_t size;
+};
+
+struct Image {
+    uint32_t fourCC = 0;
+    std::vector<Level> levels;
+    std::vector<char> data;   // all levels back to back, largest first
+};
+
+inline uint32_t blockBytes(uint32_t fourCC) {
+    return fourCC == FOURCC_DXT1 ? 8u : 16u;
+}
+
+inline size_t levelSize(uint32_t width, uint32_t height, uint32_t fourCC) {
+    size_t blocksX = (width + 3) / 4;
+    size_t blocksY = (height + 3) / 4;
+    return (blocksX > 0 ? blocksX : 1) * (blocksY > 0 ? blocksY : 1) * blockBytes(fourCC);
+}
+
+inline bool parse(const char* bytes, size_t size, Image& image) {
+    if (size < 4 + sizeof(Header))
+        return false;
+
+    uint32_t magic;
+    Header header;
+    std::memcpy(&magic, bytes, 4);
+    std::memcpy(&header, bytes + 4, sizeof(Header));
+    if (magic != MAGIC || header.size != sizeof(Header) || !(header.pixelFormat.flags & DDPF_FOURCC))
+        return false;
+    if (header.pixelFormat.fourCC != FOURCC_DXT1 && header.pixelFormat.fourCC != FOURCC_DXT5)
+        return false;
+
+    image.fourCC = header.pixelFormat.fourCC;
+    image.levels.clear();
+    uint32_t levelCount = (header.flags & DDSD_MIPMAPCOUNT) && header.mipMapCount > 0 ? header.mipMapCount : 1;
+    uint32_t width = header.width;
+    uint32_t height = header.height;
+    size_t offset = 0;
+    size_t payload = size - 4 - sizeof(Header);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        size_t bytesInLevel = levelSize(width, height, image.fourCC);
+        if (offset + bytesInLevel > payload)
+            return false;
+        image.levels.push_back({ width, height, offset, bytesInLevel });
+        offset += bytesInLevel;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    const char* first = bytes + 4 + sizeof(Header);
+    image.data.assign(first, first + offset);
+    return true;
+}
+
+inline bool load(const std::string& path, Image& image) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    std::vector<char> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(bytes.data(), bytes.size()))
+        return false;
+    return parse(bytes.data(), bytes.size(), image);
+}
+
+inline bool write(const std::string& path, const Image& image) {
+    if (image.levels.empty())
+        return false;
+
+    Header header = {};
+    header.size = sizeof(Header);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.width = image.levels[0].width;
+    header.height = image.levels[0].height;
+    header.pitchOrLinearSize = static_cast<uint32_t>(image.levels[0].size);
+    header.mipMapCount = static_cast<uint32_t>(image.levels.size());
+    header.pixelFormat.size = sizeof(PixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    header.pixelFormat.fourCC = image.fourCC;
+    header.caps = DDSCAPS_TEXTURE | (image.levels.size() > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&MAGIC), 4);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(image.data.data(), image.data.size());
+    return static_cast<bool>(file);
+}
+
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "shaderClass.h"
+#include "stream_buffer.h"
+
+// Lines for rays, bounds and other per-frame overlays. line(), box() and
+// sphere() write vertices straight into a StreamBuffer, so nothing is
+// allocated per frame; flush() draws everything written since the last
+// flush in one call, with depth testing, and starts the next frame. Lines
+// past MAX_VERTICES in a frame are dropped and counted.
+class DebugDraw {
+public:
+    static constexpr size_t MAX_VERTICES = 64 * 1024;
+    static constexpr int SPHERE_SEGMENTS = 24;
+
+    struct Stats {
+        int vertices = 0;
+        int dropped = 0;
+    };
+
+    DebugDraw()
+        : shader(VERTEX_SOURCE, FRAGMENT_SOURCE), stream(GL_ARRAY_BUFFER, MAX_VERTICES * sizeof(Vertex)) {
+        uViewProjection = shader.uniform<glm::mat4>("viewProjection");
+
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for (int i = 0; i <= SPHERE_SEGMENTS; i++) {
+            float angle = 2.0f * 3.14159265f * i / SPHERE_SEGMENTS;
+            circle[i] = glm::vec2(std::cos(angle), std::sin(angle));
+        }
+    }
+
+    ~DebugDraw() {
+        release();
+    }
+
+    DebugDraw(const DebugDraw&) = delete;
+    DebugDraw& operator=(const DebugDraw&) = delete;
+
+    void line(const glm::vec3& a, const glm::vec3& b, const glm::vec3& color) {
+        Vertex* vertices = reserve(2);
+        if (!vertices)
+            return;
+        uint32_t packed = pack(color);
+        vertices[0] = { a, packed };
+        vertices[1] = { b, packed };
+    }
+
+    // The twelve edges of a box given in the space of transform.
+    void box(const glm::mat4& transform, const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& color) {
+        Vertex* vertices = reserve(24);
+        if (!vertices)
+            return;
+        glm::vec3 corners[8];
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+            corners[i] = glm::vec3(transform * glm::vec4(corner, 1.0f));
+        }
+        // Corner pairs that differ in exactly one bit.
+        static constexpr int EDGES[12][2] = {
+            { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+            { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+            { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 },
+        };
+        uint32_t packed = pack(color);
+        for (int i = 0; i < 12; i++) {
+            vertices[i * 2] = { corners[EDGES[i][0]], packed };
+            vertices[i * 2 + 1] = { corners[EDGES[i][1]], packed };
+        }
+    }
+
+    void box(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& color) {
+        box(glm::mat4(1.0f), boxMin, boxMax, color);
+    }
+
+    // Three great circles, one around each axis.
+    void sphere(const glm::vec3& center, float radius, const glm::vec3& color) {
+        Vertex* vertices = reserve(3 * SPHERE_SEGMENTS * 2);
+        if (!vertices)
+            return;
+        uint32_t packed = pack(color);
+        for (int axis = 0; axis < 3; axis++) {
+            for (int i = 0; i < SPHERE_SEGMENTS; i++) {
+                for (int end = 0; end < 2; end++) {
+                    glm::vec2 p = circle[i + end] * radius;
+                    glm::vec3 offset = axis == 0 ? glm::vec3(0.0f, p.x, p.y) :
+                        axis == 1 ? glm::vec3(p.x, 0.0f, p.y) : glm::vec3(p.x, p.y, 0.0f);
+                    *vertices++ = { center + offset, packed };
+                }
+            }
+        }
+    }
+
+    // Draws this frame's lines into the bound framebuffer.
+    void flush(const glm::mat4& viewProjection) {
+        stats = pending;
+        pending = Stats();
+        if (stats.vertices > 0) {
+            stream.commit();
+            shader.use();
+            shader.set(uViewProjection, viewProjection);
+            glBindVertexArray(VAO);
+            glDrawArrays(GL_LINES, static_cast<GLint>(firstVertex), stats.vertices);
+            glBindVertexArray(0);
+        }
+        stream.endFrame();
+        firstVertex = SIZE_MAX;
+    }
+
+    const Stats& lastStats() const {
+        return stats;
+    }
+
+    const StreamBuffer& buffer() const {
+        return stream;
+    }
+
+    // Deletes the VAO and vertex buffer; call before the GL context goes
+    // away. Nothing may be drawn afterwards.
+    void release() {
+        if (VAO != 0)
+            glDeleteVertexArrays(1, &VAO);
+        VAO = 0;
+        stream.release();
+    }
+
+private:
+    // 16 bytes, so allocations at the default alignment stay contiguous.
+    struct Vertex {
+        glm::vec3 position;
+        uint32_t color;
+    };
+
+    static constexpr const char* VERTEX_SOURCE = R"(#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec4 aColor;
+
+out vec4 LineColor;
+
+uniform mat4 viewProjection;
+
+void main()
+{
+    LineColor = aColor;
+    gl_Position = viewProjection * vec4(aPos, 1.0);
+}
+)";
+
+    static constexpr const char* FRAGMENT_SOURCE = R"(#version 330 core
+in vec4 LineColor;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = LineColor;
+}
+)";
+
+    Shader shader;
+    Uniform<glm::mat4> uViewProjection;
+    StreamBuffer stream;
+    unsigned int VAO = 0;
+    glm::vec2 circle[SPHERE_SEGMENTS + 1];
+    size_t firstVertex = SIZE_MAX;
+    Stats pending;
+    Stats stats;
+
+    Vertex* reserve(int count) {
+        StreamBuffer::Allocation allocation = stream.allocate(count * sizeof(Vertex), sizeof(Vertex));
+        if (!allocation) {
+            pending.dropped += count;
+            return nullptr;
+        }
+        if (firstVertex == SIZE_MAX)
+            firstVertex = allocation.offset / sizeof(Vertex);
+        pending.vertices += count;
+        return static_cast<Vertex*>(allocation.data);
+    }
+
+    static uint32_t pack(const glm::vec3& color) {
+        glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+        return uint32_t(c.r) | (uint32_t(c.g) << 8) | (uint32_t(c.b) << 16) | 0xFF000000u;
+    }
+};
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+
+#include "shaderClass.h"
+
+// Renders the 3D scene into an offscreen target whose resolution follows a
+// GPU time budget, then scales it up to the window. begin() and end()
+// bracket the scene; GPU time between them is measured with timestamp
+// queries read a few frames later, so nothing waits on the GPU.
+//
+// The target is allocated at window size and the scene only uses its
+// lower-left part, so a new scale is just a new viewport. Upscaling is an
+// edge-directed filter followed by contrast-adaptive sharpening at window
+// resolution; at scale 1 only the sharpening pass runs.
+class DynamicResolution {
+public:
+    bool enabled = true;
+    float budgetMilliseconds = 12.0f;
+    float minScale = 0.5f;
+    float sharpness = 0.5f;
+
+    DynamicResolution()
+        : upscaleShader(FULLSCREEN_VERTEX, UPSCALE_FRAGMENT), sharpenShader(FULLSCREEN_VERTEX, SHARPEN_FRAGMENT) {
+        glGenVertexArrays(1, &VAO);
+        glGenQueries(QUERY_FRAMES * 2, queries);
+        for (const Shader* shader : { &upscaleShader, &sharpenShader }) {
+            shader->use();
+            shader->set(shader->uniform<int>(SOURCE), 0);
+        }
+        uUpscaleSourceScale = upscaleShader.uniform<glm::vec2>(SOURCE_SCALE);
+        uUpscaleTexelSize = upscaleShader.uniform<glm::vec2>(TEXEL_SIZE);
+        uSharpenSourceScale = sharpenShader.uniform<glm::vec2>(SOURCE_SCALE);
+        uSharpenTexelSize = sharpenShader.uniform<glm::vec2>(TEXEL_SIZE);
+        uSharpness = sharpenShader.uniform<float>(SHARPNESS);
+    }
+
+    ~DynamicResolution() {
+        release();
+    }
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // Window framebuffer size; called from the resize callback.
+    void resize(int width, int height) {
+        width = std::max(width, 1);
+        height = std::max(height, 1);
+        if (width == windowWidth && height == windowHeight)
+            return;
+        windowWidth = width;
+        windowHeight = height;
+        releaseTargets();
+        scene = createTarget(GL_RGBA8, true);
+        upscaled = createTarget(GL_RGBA8, false);
+    }
+
+    // Deletes the targets, VAO and queries; call before the GL context goes
+    // away. Nothing may be rendered through this object afterwards.
+    void release() {
+        if (VAO == 0)
+            return;
+        releaseTargets();
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteQueries(QUERY_FRAMES * 2, queries);
+        VAO = 0;
+    }
+
+    // Picks this frame's scale from the latest GPU time and binds the scene
+    // target with the viewport set to the render size.
+    void begin() {
+        readQueries();
+        if (!enabled) {
+            renderScale = 1.0f;
+        }
+        else if (gpuMilliseconds > 0.0f) {
+            // Cost grows with the pixel count, that is with scale squared.
+            float target = renderScale * std::sqrt(budgetMilliseconds / gpuMilliseconds);
+            target = glm::clamp(target, minScale, 1.0f);
+            if (std::fabs(target - renderScale) > 0.02f)
+                renderScale += (target - renderScale) * 0.25f;
+        }
+        renderScale = glm::clamp(renderScale, std::min(minScale, 1.0f), 1.0f);
+
+        glQueryCounter(queries[frame % QUERY_FRAMES * 2], GL_TIMESTAMP);
+        glBindFramebuffer(GL_FRAMEBUFFER, scene.framebuffer);
+        glViewport(0, 0, renderWidth(), renderHeight());
+    }
+
+    // Scales the scene up into the default framebuffer and leaves it bound
+    // with a window-sized viewport, for the UI.
+    void end() {
+        glQueryCounter(queries[frame % QUERY_FRAMES * 2 + 1], GL_TIMESTAMP);
+        frame++;
+
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(VAO);
+        glActiveTexture(GL_TEXTURE0);
+
+        glm::vec2 texelSize(1.0f / windowWidth, 1.0f / windowHeight);
+        const Target* source = &scene;
+        glm::vec2 sourceScale(float(renderWidth()) / windowWidth, float(renderHeight()) / windowHeight);
+        if (renderWidth() != windowWidth || renderHeight() != windowHeight) {
+            glBindFramebuffer(GL_FRAMEBUFFER, upscaled.framebuffer);
+            glViewport(0, 0, windowWidth, windowHeight);
+            upscaleShader.use();
+            upscaleShader.set(uUpscaleSourceScale, sourceScale);
+            upscaleShader.set(uUpscaleTexelSize, texelSize);
+            glBindTexture(GL_TEXTURE_2D, scene.color);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            source = &upscaled;
+            sourceScale = glm::vec2(1.0f);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+        sharpenShader.use();
+        sharpenShader.set(uSharpenSourceScale, sourceScale);
+        sharpenShader.set(uSharpenTexelSize, texelSize);
+        sharpenShader.set(uSharpness, sharpness);
+        glBindTexture(GL_TEXTURE_2D, source->color);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+    float scale() const {
+        return renderScale;
+    }
+
+    int renderWidth() const {
+        return std::max(1, static_cast<int>(windowWidth * renderScale + 0.5f));
+    }
+
+    int renderHeight() const {
+        return std::max(1, static_cast<int>(windowHeight * renderScale + 0.5f));
+    }
+
+    // GPU time of the scene a few frames ago, 0 until the first result.
+    float lastGpuMilliseconds() const {
+        return gpuMilliseconds;
+    }
+
+private:
+    static constexpr int QUERY_FRAMES = 4;
+    static constexpr UniformName SOURCE = "source";
+    static constexpr UniformName SOURCE_SCALE = "sourceScale";
+    static constexpr UniformName TEXEL_SIZE = "texelSize";
+    static constexpr UniformName SHARPNESS = "sharpness";
+
+    // One triangle covering the screen, from gl_VertexID alone.
+    static constexpr const char* FULLSCREEN_VERTEX = R"(#version 330 core
+out vec2 uv;
+
+void main()
+{
+    uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+    // Filters along the local edge, found from the luma gradient, so edges
+    // stay sharp while their stairs are smoothed, then clamps to the four
+    // nearest source texels so the filter cannot ring.
+    static constexpr const char* UPSCALE_FRAGMENT = R"(#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 sourceScale;
+uniform vec2 texelSize;
+
+vec3 fetch(vec2 p)
+{
+    return texture(source, clamp(p, texelSize * 0.5, sourceScale - texelSize * 0.5)).rgb;
+}
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 p = uv * sourceScale;
+    vec3 center = fetch(p);
+    vec2 gradient = vec2(luma(fetch(p + vec2(texelSize.x, 0.0))) - luma(fetch(p - vec2(texelSize.x, 0.0))),
+        luma(fetch(p + vec2(0.0, texelSize.y))) - luma(fetch(p - vec2(0.0, texelSize.y))));
+    float strength = length(gradient);
+
+    vec3 result = center;
+    if (strength > 1.0 / 64.0)
+    {
+        vec2 along = vec2(-gradient.y, gradient.x) / strength * texelSize;
+        vec3 inner = fetch(p + along * 0.5) + fetch(p - along * 0.5);
+        vec3 outer = fetch(p + along) + fetch(p - along);
+        vec3 smoothed = (center * 2.0 + inner + outer * 0.5) / 5.0;
+        result = mix(center, smoothed, clamp(strength * 4.0, 0.0, 1.0));
+    }
+
+    vec2 corner = (floor(p / texelSize - 0.5) + 0.5) * texelSize;
+    vec3 a = fetch(corner), b = fetch(corner + vec2(texelSize.x, 0.0));
+    vec3 c = fetch(corner + vec2(0.0, texelSize.y)), d = fetch(corner + texelSize);
+    result = clamp(result, min(min(a, b), min(c, d)), max(max(a, b), max(c, d)));
+    FragColor = vec4(result, 1.0);
+}
+)";
+
+    // Contrast-adaptive sharpening: the negative lobe shrinks where the
+    // neighborhood is already near black or white, so it never clips.
+    static constexpr const char* SHARPEN_FRAGMENT = R"(#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 sourceScale;
+uniform vec2 texelSize;
+uniform float sharpness;
+
+void main()
+{
+    vec2 p = uv * sourceScale;
+    vec3 e = texture(source, p).rgb;
+    vec3 b = texture(source, p + vec2(0.0, texelSize.y)).rgb;
+    vec3 d = texture(source, p - vec2(texelSize.x, 0.0)).rgb;
+    vec3 f = texture(source, p + vec2(texelSize.x, 0.0)).rgb;
+    vec3 h = texture(source, p - vec2(0.0, texelSize.y)).rgb;
+
+    vec3 lo = min(e, min(min(b, d), min(f, h)));
+    vec3 hi = max(e, max(max(b, d), max(f, h)));
+    vec3 amount = sqrt(clamp(min(lo, 1.0 - hi) / max(hi, vec3(1.0 / 256.0)), 0.0, 1.0));
+    vec3 w = -amount * mix(0.125, 0.2, sharpness);
+    FragColor = vec4(clamp((e + (b + d + f + h) * w) / (1.0 + 4.0 * w), 0.0, 1.0), 1.0);
+}
+)";
+
+    struct Target {
+        unsigned int framebuffer = 0;
+        unsigned int color = 0;
+        unsigned int depth = 0;
+    };
+
+    Shader upscaleShader;
+    Shader sharpenShader;
+    Uniform<glm::vec2> uUpscaleSourceScale, uUpscaleTexelSize;
+    Uniform<glm::vec2> uSharpenSourceScale, uSharpenTexelSize;
+    Uniform<float> uSharpness;
+    unsigned int VAO = 0;
+    unsigned int queries[QUERY_FRAMES * 2] = {};
+    uint64_t frame = 0;
+    uint64_t measuredFrame = 0;
+    int windowWidth = 0;
+    int windowHeight = 0;
+    float renderScale = 1.0f;
+    float gpuMilliseconds = 0.0f;
+    Target scene;
+    Target upscaled;
+
+    Target createTarget(GLenum format, bool withDepth) {
+        Target target;
+        glGenTextures(1, &target.color);
+        glBindTexture(GL_TEXTURE_2D, target.color);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, windowWidth, windowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &target.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+        if (withDepth) {
+            glGenRenderbuffers(1, &target.depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "WARN: scene render target incomplete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return target;
+    }
+
+    void releaseTargets() {
+        for (Target* target : { &scene, &upscaled }) {
+            glDeleteFramebuffers(1, &target->framebuffer);
+            glDeleteTextures(1, &target->color);
+            glDeleteRenderbuffers(1, &target->depth);
+            *target = Target();
+        }
+    }
+
+    // Reads every finished frame's timestamps, oldest first.
+    void readQueries() {
+        if (frame >= measuredFrame + QUERY_FRAMES)
+            measuredFrame = frame - QUERY_FRAMES + 1;
+        while (measuredFrame < frame) {
+            unsigned int* pair = &queries[measuredFrame % QUERY_FRAMES * 2];
+            GLint available = 0;
+            glGetQueryObjectiv(pair[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 start = 0, stop = 0;
+            glGetQueryObjectui64v(pair[0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(pair[1], GL_QUERY_RESULT, &stop);
+            gpuMilliseconds = static_cast<float>(stop - start) / 1.0e6f;
+            measuredFrame++;
+        }
+    }
+};
+
+#endif
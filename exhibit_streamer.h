@@ -0,0 +1,228 @@
+#ifndef EXHIBIT_STREAMER_H
+#define EXHIBIT_STREAMER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "asset_loader.h"
+#include "mesh_cache.h"
+#include "model.h"
+#include "render_queue.h"
+#include "shaderClass.h"
+#include "transform_buffer.h"
+
+// Keeps exhibits resident only while they are needed. Every update() the
+// exhibits within loadRadius of a focus point (camera, robot) are queued on
+// the AssetLoader; once the resident models use more than budgetBytes, the
+// ones that have been out of range the longest are dropped. Exhibits that
+// are not resident draw a box of their bounds instead.
+class ExhibitStreamer {
+public:
+    enum class State { Unloaded, Loading, Resident };
+
+    struct Exhibit {
+        std::string path;
+        glm::mat4 transform;
+        // Holds transform, and the placeholder box's scaled transform once a
+        // box has been drawn for the exhibit.
+        TransformSlot slot;
+        std::optional<TransformSlot> boxSlot;
+        // Object space. Read from the mesh cache up front and from the
+        // model once it has loaded; a unit box until either is known.
+        glm::vec3 boundsMin = glm::vec3(-0.5f);
+        glm::vec3 boundsMax = glm::vec3(0.5f);
+        std::unique_ptr<Model> model;
+        State state = State::Unloaded;
+        size_t bytes = 0;
+        uint64_t lastInRange = 0;
+
+        // World-space sphere around the bounds.
+        void boundingSphere(glm::vec3& center, float& radius) const {
+            center = glm::vec3(transform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+            float scale = std::max(glm::length(glm::vec3(transform[0])),
+                std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+            radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+        }
+    };
+
+    float loadRadius = 20.0f;
+    size_t budgetBytes = size_t(512) << 20;
+
+    explicit ExhibitStreamer(AssetLoader& loader) : loader(loader) {
+    }
+
+    ~ExhibitStreamer() {
+        clear();
+    }
+
+    ExhibitStreamer(const ExhibitStreamer&) = delete;
+    ExhibitStreamer& operator=(const ExhibitStreamer&) = delete;
+
+    size_t add(const std::string& path, const glm::mat4& transform) {
+        exhibits.push_back(std::make_unique<Exhibit>());
+        Exhibit& exhibit = *exhibits.back();
+        exhibit.path = path;
+        exhibit.transform = transform;
+        exhibit.slot.set(transform);
+        MeshCache::loadBounds(path, exhibit.boundsMin, exhibit.boundsMax);
+        return exhibits.size() - 1;
+    }
+
+    // Requests exhibits near any focus point and evicts over budget. Only
+    // queues work; finished loads arrive through AssetLoader::pump().
+    void update(const std::vector<glm::vec3>& focusPoints) {
+        frame++;
+        for (size_t i = 0; i < exhibits.size(); i++) {
+            Exhibit& exhibit = *exhibits[i];
+            if (!inRange(exhibit, focusPoints))
+                continue;
+            exhibit.lastInRange = frame;
+            if (exhibit.state == State::Unloaded)
+                request(i);
+        }
+
+        while (residentBytes() > budgetBytes) {
+            Exhibit* victim = nullptr;
+            for (auto& exhibit : exhibits) {
+                if (exhibit->state == State::Resident && exhibit->lastInRange != frame &&
+                    (!victim || exhibit->lastInRange < victim->lastInRange))
+                    victim = exhibit.get();
+            }
+            // Everything resident is in use; stay over budget rather than thrash.
+            if (!victim)
+                break;
+            victim->model.reset();
+            victim->state = State::Unloaded;
+            victim->bytes = 0;
+            version++;
+        }
+    }
+
+    size_t count() const {
+        return exhibits.size();
+    }
+
+    const Exhibit& exhibit(size_t i) const {
+        return *exhibits[i];
+    }
+
+    size_t residentBytes() const {
+        size_t bytes = 0;
+        for (const auto& exhibit : exhibits)
+            bytes += exhibit->bytes;
+        return bytes;
+    }
+
+    // Changes whenever a model becomes resident or is dropped, so callers
+    // can tell when the set of drawn models is no longer the same.
+    uint64_t residentVersion() const {
+        return version;
+    }
+
+    size_t countIn(State state) const {
+        size_t result = 0;
+        for (const auto& exhibit : exhibits)
+            result += exhibit->state == state ? 1 : 0;
+        return result;
+    }
+
+    // Queues the exhibit's bounding box: a unit cube scaled to the bounds,
+    // kept in the geometry pool like any other model.
+    void submitPlaceholder(RenderQueue& queue, ShaderVariants& shaders, size_t i) {
+        Exhibit& exhibit = *exhibits[i];
+        if (!box)
+            createBox();
+
+        glm::vec3 extent = glm::max(exhibit.boundsMax - exhibit.boundsMin, glm::vec3(1e-4f));
+        if (!exhibit.boxSlot)
+            exhibit.boxSlot.emplace();
+        exhibit.boxSlot->set(glm::scale(glm::translate(exhibit.transform, exhibit.boundsMin), extent));
+        box->submit(queue, shaders, exhibit.boxSlot->index(), glm::vec3(0.55f, 0.55f, 0.6f), false);
+    }
+
+    // Frees every model and the box; call while the GL context is alive.
+    // Loads still in flight are dropped when they arrive.
+    void clear() {
+        for (auto& exhibit : exhibits) {
+            exhibit->model.reset();
+            exhibit->bytes = 0;
+        }
+        version++;
+        box.reset();
+        *alive = false;
+    }
+
+private:
+    AssetLoader& loader;
+    // Exhibits are held by pointer so load callbacks can keep theirs.
+    std::vector<std::unique_ptr<Exhibit>> exhibits;
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+    uint64_t frame = 0;
+    uint64_t version = 0;
+    std::unique_ptr<Model> box;
+
+    // Distance from the focus point to the exhibit's bounding sphere.
+    bool inRange(const Exhibit& exhibit, const std::vector<glm::vec3>& focusPoints) const {
+        glm::vec3 center;
+        float radius;
+        exhibit.boundingSphere(center, radius);
+        for (const glm::vec3& point : focusPoints) {
+            if (glm::length(center - point) - radius < loadRadius)
+                return true;
+        }
+        return false;
+    }
+
+    void request(size_t i) {
+        Exhibit* exhibit = exhibits[i].get();
+        exhibit->state = State::Loading;
+        std::shared_ptr<bool> owner = alive;
+        loader.loadModel(exhibit->path, [this, exhibit, owner](std::unique_ptr<Model> model) {
+            if (!*owner)
+                return;
+            exhibit->boundsMin = model->boundsMin;
+            exhibit->boundsMax = model->boundsMax;
+            exhibit->bytes = model->memoryBytes();
+            exhibit->model = std::move(model);
+            exhibit->state = State::Resident;
+            exhibit->boxSlot.reset();
+            version++;
+        });
+    }
+
+    void createBox() {
+        // Unit cube with flat normals, four corners per face.
+        static const float corners[] = {
+            0,0,0, -1,0,0,  0,1,0, -1,0,0,  0,1,1, -1,0,0,  0,0,1, -1,0,0,
+            1,0,0,  1,0,0,  1,0,1,  1,0,0,  1,1,1,  1,0,0,  1,1,0,  1,0,0,
+            0,0,0,  0,-1,0, 0,0,1,  0,-1,0, 1,0,1,  0,-1,0, 1,0,0,  0,-1,0,
+            0,1,0,  0,1,0,  1,1,0,  0,1,0,  1,1,1,  0,1,0,  0,1,1,  0,1,0,
+            0,0,0,  0,0,-1, 1,0,0,  0,0,-1, 1,1,0,  0,0,-1, 0,1,0,  0,0,-1,
+            0,0,1,  0,0,1,  0,1,1,  0,0,1,  1,1,1,  0,0,1,  1,0,1,  0,0,1
+        };
+        MeshData mesh;
+        for (unsigned int v = 0; v < 24; v++) {
+            Vertex vertex = {};
+            vertex.Position = glm::vec3(corners[v * 6], corners[v * 6 + 1], corners[v * 6 + 2]);
+            vertex.Normal = glm::vec3(corners[v * 6 + 3], corners[v * 6 + 4], corners[v * 6 + 5]);
+            mesh.vertices.push_back(vertex);
+        }
+        for (unsigned int face = 0; face < 6; face++) {
+            unsigned int base = face * 4;
+            mesh.indices.insert(mesh.indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+        }
+        mesh.boundsMax = glm::vec3(1.0f);
+
+        ModelData data;
+        data.meshes.push_back(std::move(mesh));
+        box = std::make_unique<Model>(std::move(data));
+    }
+};
+
+#endif
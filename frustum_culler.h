@@ -0,0 +1,184 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX__)
+#define FRUSTUM_CULLER_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLER_SSE2
+#include <emmintrin.h>
+#endif
+
+// The six planes of a view-projection matrix (Gribb/Hartmann), normals
+// pointing inwards: a point p is inside when dot(xyz, p) + w >= 0 for all.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection) {
+        glm::mat4 m = glm::transpose(viewProjection);
+        Frustum frustum;
+        frustum.planes[0] = m[3] + m[0];
+        frustum.planes[1] = m[3] - m[0];
+        frustum.planes[2] = m[3] + m[1];
+        frustum.planes[3] = m[3] - m[1];
+        frustum.planes[4] = m[3] + m[2];
+        frustum.planes[5] = m[3] - m[2];
+        return frustum;
+    }
+};
+
+// Culls a batch of world-space bounds against a frustum. Every entry is an
+// AABB (center, half extent) plus the radius of a sphere around the same
+// center, and is rejected by a plane when it lies behind it by more than
+// the smaller of the two. The bounds are kept as structure-of-arrays and
+// tested four at a time with SSE2, or eight with AVX builds.
+//
+// Per frame: clear(), add() each candidate, cull(), then read visible(i)
+// in add() order.
+class FrustumCuller {
+public:
+    void clear() {
+        count = 0;
+        forEachLane([](std::vector<float>& lane) { lane.clear(); });
+    }
+
+    // Transforms object-space bounds by transform (Arvo's method for the
+    // box, the largest axis scale for the sphere) and returns the index.
+    size_t add(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float radius) {
+        glm::vec3 center = glm::vec3(transform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+        glm::vec3 extent = glm::abs(glm::vec3(transform[0])) * halfExtent.x +
+            glm::abs(glm::vec3(transform[1])) * halfExtent.y + glm::abs(glm::vec3(transform[2])) * halfExtent.z;
+        float scale = std::max(glm::length(glm::vec3(transform[0])),
+            std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        return addWorld(center, extent, radius * scale);
+    }
+
+    size_t addWorld(const glm::vec3& center, const glm::vec3& extent, float radius) {
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        extentX.push_back(extent.x);
+        extentY.push_back(extent.y);
+        extentZ.push_back(extent.z);
+        radii.push_back(radius);
+        return count++;
+    }
+
+    void cull(const Frustum& frustum) {
+        // Pad to whole SIMD groups; the padding's results are dropped.
+        size_t padded = (count + LANES - 1) / LANES * LANES;
+        forEachLane([padded](std::vector<float>& lane) { lane.resize(padded, 0.0f); });
+        visibility.assign(padded, 1);
+
+        for (size_t i = 0; i < padded; i += LANES)
+            cullGroup(frustum, i);
+
+        forEachLane([this](std::vector<float>& lane) { lane.resize(count); });
+        visibility.resize(count);
+    }
+
+    bool visible(size_t i) const {
+        return visibility[i] != 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t visibleCount() const {
+        return static_cast<size_t>(std::count(visibility.begin(), visibility.end(), 1));
+    }
+
+private:
+#if defined(FRUSTUM_CULLER_AVX)
+    static constexpr size_t LANES = 8;
+#else
+    static constexpr size_t LANES = 4;
+#endif
+
+    size_t count = 0;
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radii;
+    std::vector<uint8_t> visibility;
+
+    template <typename F>
+    void forEachLane(F f) {
+        f(centerX);
+        f(centerY);
+        f(centerZ);
+        f(extentX);
+        f(extentY);
+        f(extentZ);
+        f(radii);
+    }
+
+#if defined(FRUSTUM_CULLER_AVX)
+    void cullGroup(const Frustum& frustum, size_t i) {
+        __m256 cx = _mm256_loadu_ps(&centerX[i]), cy = _mm256_loadu_ps(&centerY[i]), cz = _mm256_loadu_ps(&centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&extentX[i]), ey = _mm256_loadu_ps(&extentY[i]), ez = _mm256_loadu_ps(&extentZ[i]);
+        __m256 r = _mm256_loadu_ps(&radii[i]);
+        __m256 outside = _mm256_setzero_ps();
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)),
+                _mm256_mul_ps(cy, _mm256_set1_ps(plane.y))),
+                _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+            __m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(std::fabs(plane.x))),
+                _mm256_mul_ps(ey, _mm256_set1_ps(std::fabs(plane.y)))), _mm256_mul_ps(ez, _mm256_set1_ps(std::fabs(plane.z))));
+            __m256 sphereRadius = _mm256_mul_ps(r, _mm256_set1_ps(glm::length(glm::vec3(plane))));
+            __m256 reach = _mm256_min_ps(boxRadius, sphereRadius);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        storeMask(i, _mm256_movemask_ps(outside));
+    }
+#elif defined(FRUSTUM_CULLER_SSE2)
+    void cullGroup(const Frustum& frustum, size_t i) {
+        __m128 cx = _mm_loadu_ps(&centerX[i]), cy = _mm_loadu_ps(&centerY[i]), cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+        __m128 r = _mm_loadu_ps(&radii[i]);
+        __m128 outside = _mm_setzero_ps();
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x))),
+                _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y)))), _mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+            __m128 sphereRadius = _mm_mul_ps(r, _mm_set1_ps(glm::length(glm::vec3(plane))));
+            __m128 reach = _mm_min_ps(boxRadius, sphereRadius);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+        storeMask(i, _mm_movemask_ps(outside));
+    }
+#else
+    void cullGroup(const Frustum& frustum, size_t i) {
+        int mask = 0;
+        for (size_t lane = 0; lane < LANES; lane++) {
+            size_t k = i + lane;
+            for (const glm::vec4& plane : frustum.planes) {
+                float distance = centerX[k] * plane.x + centerY[k] * plane.y + centerZ[k] * plane.z + plane.w;
+                float boxRadius = extentX[k] * std::fabs(plane.x) + extentY[k] * std::fabs(plane.y) +
+                    extentZ[k] * std::fabs(plane.z);
+                float sphereRadius = radii[k] * glm::length(glm::vec3(plane));
+                if (distance + std::min(boxRadius, sphereRadius) < 0.0f) {
+                    mask |= 1 << lane;
+                    break;
+                }
+            }
+        }
+        storeMask(i, mask);
+    }
+#endif
+
+    void storeMask(size_t i, int outsideMask) {
+        for (size_t lane = 0; lane < LANES; lane++)
+            visibility[i + lane] = (outsideMask >> lane) & 1 ? 0 : 1;
+    }
+};
+
+#endif
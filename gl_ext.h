@@ -0,0 +1,138 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+#include <cstring>
+
+// glad was generated for plain GL 3.3 core, so enums and entry points from
+// extensions or later versions are declared here by hand.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_VERSION_4_3
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect,
+    GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLPUSHDEBUGGROUPPROC)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+typedef void (APIENTRYP PFNGLPOPDEBUGGROUPPROC)(void);
+#endif
+
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length,
+    GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+#endif
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+#endif
+
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+#endif
+
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Context capabilities and the entry points glad does not load, filled once
+// by GLExt::init() on the main thread right after gladLoadGLLoader. Read-only afterwards, so worker threads may
+// consult them when deciding what to prepare for upload.
+struct GLExt {
+    static inline int major = 3;
+    static inline int minor = 3;
+    static inline bool textureCompressionS3TC = false;
+    // GL 4.3: glMultiDrawElementsIndirect, with baseInstance honored.
+    static inline bool multiDrawIndirect = false;
+    // GL 4.1 or ARB_get_program_binary, with at least one binary format.
+    static inline bool programBinary = false;
+    // KHR/ARB_parallel_shader_compile: GL_COMPLETION_STATUS_KHR can be
+    // polled without waiting for the compile.
+    static inline bool parallelShaderCompile = false;
+    // GL 4.4 or ARB_buffer_storage: immutable buffers that stay mapped.
+    static inline bool bufferStorage = false;
+    // GL 4.3 or KHR_debug: named groups that capture tools show.
+    static inline bool debugGroups = false;
+
+    static inline PFNGLMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+    static inline PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+    static inline PFNGLPROGRAMBINARYPROC programBinaryLoad = nullptr;
+    static inline PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+    static inline PFNGLBUFFERSTORAGEPROC bufferStorageCreate = nullptr;
+    static inline PFNGLPUSHDEBUGGROUPPROC pushDebugGroup = nullptr;
+    static inline PFNGLPOPDEBUGGROUPPROC popDebugGroup = nullptr;
+
+    static void init(GLADloadproc load) {
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        textureCompressionS3TC = hasExtension("GL_EXT_texture_compression_s3tc");
+
+        if (versionAtLeast(4, 3))
+            multiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+        multiDrawIndirect = multiDrawElementsIndirect != nullptr;
+
+        if (versionAtLeast(4, 1) || hasExtension("GL_ARB_get_program_binary")) {
+            getProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+            programBinaryLoad = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+            programParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+        }
+        GLint binaryFormats = 0;
+        if (getProgramBinary && programBinaryLoad && programParameteri)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+        programBinary = binaryFormats > 0;
+
+        if (versionAtLeast(4, 4) || hasExtension("GL_ARB_buffer_storage"))
+            bufferStorageCreate = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+        bufferStorage = bufferStorageCreate != nullptr;
+
+        if (versionAtLeast(4, 3) || hasExtension("GL_KHR_debug")) {
+            pushDebugGroup = (PFNGLPUSHDEBUGGROUPPROC)load("glPushDebugGroup");
+            popDebugGroup = (PFNGLPOPDEBUGGROUPPROC)load("glPopDebugGroup");
+        }
+        debugGroups = pushDebugGroup && popDebugGroup;
+
+        // Let the driver use as many compiler threads as it likes.
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxCompilerThreads = nullptr;
+        if (hasExtension("GL_KHR_parallel_shader_compile"))
+            maxCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+        else if (hasExtension("GL_ARB_parallel_shader_compile"))
+            maxCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+        if (maxCompilerThreads)
+            maxCompilerThreads(0xFFFFFFFFu);
+        parallelShaderCompile = maxCompilerThreads != nullptr;
+    }
+
+    static bool versionAtLeast(int wantMajor, int wantMinor) {
+        return major > wantMajor || (major == wantMajor && minor >= wantMinor);
+    }
+
+    static bool hasExtension(const char* name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (ext && std::strcmp(ext, name) == 0)
+                return true;
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "gl_ext.h"
+
+// GPU time per named section of the frame. push() and pop() bracket a
+// section with timestamp queries, so sections nest, and with a KHR_debug
+// group of the same name for capture tools. Each frame's queries are read
+// when the GPU is done with them, up to FRAMES frames later, without
+// waiting; a frame whose results are still missing when its queries come
+// round again is dropped.
+//
+// Sections are identified by name and nesting depth and listed in the
+// order they first appeared. Each keeps its last HISTORY frames.
+class GpuProfiler {
+public:
+    static constexpr int FRAMES = 4;
+    static constexpr int HISTORY = 240;
+
+    struct Section {
+        std::string name;
+        int depth = 0;
+        float history[HISTORY] = {};  // milliseconds, oldest at historyStart()
+        float milliseconds = 0.0f;    // latest frame
+        float average = 0.0f;         // over the history
+    };
+
+    // Timing on or off; debug groups are emitted either way.
+    bool enabled = true;
+
+    GpuProfiler() = default;
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    ~GpuProfiler() {
+        release();
+    }
+
+    void beginFrame() {
+        collect();
+        Frame& frame = frames[frameIndex % FRAMES];
+        if (frame.pending) {
+            frame.pending = false;
+            dropped++;
+        }
+        frame.markers.clear();
+        stack.clear();
+    }
+
+    void push(const char* name) {
+        if (GLExt::debugGroups)
+            GLExt::pushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+        if (!enabled) {
+            stack.push_back(-1);
+            return;
+        }
+
+        Frame& frame = frames[frameIndex % FRAMES];
+        size_t marker = frame.markers.size();
+        if (frame.queries.size() < (marker + 1) * 2) {
+            size_t old = frame.queries.size();
+            frame.queries.resize(std::max<size_t>(16, old * 2));
+            glGenQueries(static_cast<GLsizei>(frame.queries.size() - old), frame.queries.data() + old);
+        }
+        frame.markers.push_back({ section(name, static_cast<int>(stack.size())), static_cast<uint32_t>(marker * 2) });
+        frame.last = frame.queries[marker * 2];
+        glQueryCounter(frame.last, GL_TIMESTAMP);
+        stack.push_back(static_cast<int>(marker));
+    }
+
+    void pop() {
+        if (stack.empty())
+            return;
+        int marker = stack.back();
+        stack.pop_back();
+        if (marker >= 0) {
+            Frame& frame = frames[frameIndex % FRAMES];
+            frame.last = frame.queries[frame.markers[marker].query + 1];
+            glQueryCounter(frame.last, GL_TIMESTAMP);
+        }
+        if (GLExt::debugGroups)
+            GLExt::popDebugGroup();
+    }
+
+    void endFrame() {
+        while (!stack.empty())
+            pop();
+        Frame& frame = frames[frameIndex % FRAMES];
+        frame.pending = !frame.markers.empty();
+        frameIndex++;
+    }
+
+    const std::vector<Section>& sections() const {
+        return sectionList;
+    }
+
+    // Index of the oldest value in every Section::history.
+    int historyStart() const {
+        return static_cast<int>(recorded % HISTORY);
+    }
+
+    // Frames whose results were never read.
+    int droppedFrames() const {
+        return dropped;
+    }
+
+    // The history as CSV: one column per section, one row per frame, oldest
+    // first.
+    bool exportCsv(const std::string& path) const {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file) {
+            std::cerr << "WARN: could not write " << path << std::endl;
+            return false;
+        }
+        file << "frame";
+        for (const Section& section : sectionList)
+            file << ",\"" << std::string(section.depth * 2, ' ') << section.name << " (ms)\"";
+        file << "\n";
+        int rows = static_cast<int>(std::min<uint64_t>(recorded, HISTORY));
+        for (int row = 0; row < rows; row++) {
+            int index = static_cast<int>((recorded - rows + row) % HISTORY);
+            file << row;
+            for (const Section& section : sectionList)
+                file << "," << section.history[index];
+            file << "\n";
+        }
+        return static_cast<bool>(file);
+    }
+
+    // Deletes every frame's queries, dropping results not yet read; call
+    // before the GL context goes away.
+    void release() {
+        for (Frame& frame : frames) {
+            if (!frame.queries.empty())
+                glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+            frame = Frame();
+        }
+    }
+
+private:
+    struct Marker {
+        int section;
+        uint32_t query;    // begin timestamp; the end one follows it
+    };
+
+    struct Frame {
+        std::vector<GLuint> queries;
+        std::vector<Marker> markers;
+        GLuint last = 0;   // issued last, so available last
+        bool pending = false;
+    };
+
+    Frame frames[FRAMES];
+    uint64_t frameIndex = 0;
+    uint64_t recorded = 0;
+    int dropped = 0;
+    std::vector<int> stack;
+    std::vector<Section> sectionList;
+    std::vector<float> frameTotals;
+
+    int section(const char* name, int depth) {
+        for (size_t i = 0; i < sectionList.size(); i++) {
+            if (sectionList[i].depth == depth && sectionList[i].name == name)
+                return static_cast<int>(i);
+        }
+        Section added;
+        added.name = name;
+        added.depth = depth;
+        sectionList.push_back(added);
+        return static_cast<int>(sectionList.size() - 1);
+    }
+
+    // Reads finished frames oldest first, stopping at the first one the
+    // GPU has not finished.
+    void collect() {
+        uint64_t first = frameIndex >= FRAMES ? frameIndex - FRAMES : 0;
+        for (uint64_t index = first; index < frameIndex; index++) {
+            Frame& frame = frames[index % FRAMES];
+            if (!frame.pending)
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(frame.last, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            frame.pending = false;
+
+            frameTotals.assign(sectionList.size(), 0.0f);
+            for (const Marker& marker : frame.markers) {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(frame.queries[marker.query], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.queries[marker.query + 1], GL_QUERY_RESULT, &end);
+                frameTotals[marker.section] += static_cast<float>(end - begin) / 1.0e6f;
+            }
+            int slot = static_cast<int>(recorded % HISTORY);
+            recorded++;
+            for (size_t i = 0; i < sectionList.size(); i++) {
+                Section& section = sectionList[i];
+                section.average += (frameTotals[i] - section.history[slot]) / HISTORY;
+                section.history[slot] = frameTotals[i];
+                section.milliseconds = frameTotals[i];
+            }
+        }
+    }
+};
+
+#endif
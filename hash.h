@@ -0,0 +1,28 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a. Used for content keys (mesh cache sources, texture
+// deduplication), not for anything security related.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Same hash over a NUL-terminated string; usable in constant expressions,
+// so names known at compile time cost nothing at run time.
+constexpr uint64_t hashString(const char* text, uint64_t hash = 14695981039346656037ull) {
+    for (; *text; text++) {
+        hash ^= static_cast<unsigned char>(*text);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// Per-instance vertex data: read by the vertex shader as
+// layout(location = 3) uint aTransform, the object's TransformBuffer slot,
+// layout(location = 4) vec4 aInstanceColor and
+// layout(location = 5/6) vec3 aPosOffset/aPosScale, the packed-position
+// remap of the mesh being drawn.
+struct InstanceData {
+    uint32_t transform;
+    glm::vec4 color;
+    glm::vec3 posOffset = glm::vec3(0.0f);
+    glm::vec3 posScale = glm::vec3(1.0f);
+};
+
+// One streaming vertex buffer shared by every instanced draw. upload()
+// orphans the previous contents, so draws already issued keep theirs; call
+// bindAttributes() with the target VAO bound to point locations 3..6 at the
+// instances starting from firstInstance.
+class InstanceBuffer {
+public:
+    static constexpr GLuint FIRST_LOCATION = 3;
+
+    static InstanceBuffer& instance() {
+        static InstanceBuffer buffer;
+        return buffer;
+    }
+
+    void upload(const InstanceData* instances, size_t count) {
+        if (VBO == 0)
+            glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        while (capacity < count)
+            capacity = capacity == 0 ? 256 : capacity * 2;
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+    }
+
+    void bindAttributes(size_t firstInstance) const {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        size_t base = firstInstance * sizeof(InstanceData);
+        glEnableVertexAttribArray(FIRST_LOCATION);
+        glVertexAttribIPointer(FIRST_LOCATION, 1, GL_UNSIGNED_INT, sizeof(InstanceData),
+            (void*)(base + offsetof(InstanceData, transform)));
+        glVertexAttribDivisor(FIRST_LOCATION, 1);
+        pointAt(FIRST_LOCATION + 1, 4, base + offsetof(InstanceData, color));
+        pointAt(FIRST_LOCATION + 2, 3, base + offsetof(InstanceData, posOffset));
+        pointAt(FIRST_LOCATION + 3, 3, base + offsetof(InstanceData, posScale));
+    }
+
+private:
+    unsigned int VBO = 0;
+    size_t capacity = 0;
+
+    static void pointAt(GLuint location, GLint components, size_t offset) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, components, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offset);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    InstanceBuffer() = default;
+};
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef LIGHT_BUFFER_H
+#define LIGHT_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "shaderClass.h"
+
+// One spot or point light. color is already scaled by intensity. Nothing
+// is lit beyond range; a point light's cosCutoff of -2 lets every direction
+// pass the cone test. shadow is the light's ShadowAtlas view, -1 for none.
+struct Light {
+    glm::vec3 position;
+    float range;
+    glm::vec3 color;
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    float cosCutoff = -2.0f;
+    int shadow = -1;
+
+    static Light point(const glm::vec3& position, const glm::vec3& color, float intensity, float range) {
+        return { position, range, color * intensity };
+    }
+
+    static Light spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float intensity,
+        float cutOffDegrees, float range) {
+        return { position, range, color * intensity, glm::normalize(direction), glm::cos(glm::radians(cutOffDegrees)) };
+    }
+
+    // Smallest sphere around the lit volume: the whole range for a point
+    // light, the cone for a spot.
+    void boundingSphere(glm::vec3& center, float& radius) const {
+        if (cosCutoff <= 0.0f) {
+            center = position;
+            radius = range;
+            return;
+        }
+        float coneRadius = range * std::sqrt(1.0f - cosCutoff * cosCutoff) / cosCutoff;
+        float distance = (range * range + coneRadius * coneRadius) / (2.0f * range);
+        if (distance > range) {
+            center = position + direction * range;
+            radius = coneRadius;
+        }
+        else {
+            center = position + direction * distance;
+            radius = distance;
+        }
+    }
+};
+
+// C++ mirror of the std140 LightBlock uniform block (LIGHT_BLOCK_GLSL).
+// Only vec4/ivec4 members, so the std140 layout is the plain struct layout.
+// The cluster fields are filled by LightBuffer::update.
+struct LightBlock {
+    glm::vec4 ceilingPosition;  // xyz position, w intensity
+    glm::vec4 ceilingColor;     // rgb, w ShadowAtlas view or -1
+    glm::vec4 lightColor;       // rgb, ambient
+    glm::ivec4 clusterCounts;   // xyz clusters per axis, w lights
+    glm::vec4 clusterParams;    // x/y depth slice scale/bias, zw tile size in pixels
+};
+
+static_assert(sizeof(LightBlock) == 5 * 16, "LightBlock must match its std140 layout");
+
+// GLSL declarations matching LightBlock and the light buffers, to insert
+// after #version in any shader that needs lights. A fragment finds its
+// cluster with lightCluster() and reads (first, count) of its light index
+// list from lightGrid; lightData holds three texels per light: position
+// and range, color and shadow view, direction and cos(cutoff).
+inline constexpr const char* LIGHT_BLOCK_GLSL = R"(
+layout(std140) uniform LightBlock {
+    vec4 ceilingPosition;
+    vec4 ceilingColor;
+    vec4 lightColor;
+    ivec4 clusterCounts;
+    vec4 clusterParams;
+};
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+
+int lightCluster(float viewDepth)
+{
+    int slice = int(max(log(viewDepth) * clusterParams.x + clusterParams.y, 0.0));
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterParams.zw), clusterCounts.xy - 1);
+    return tile.x + clusterCounts.x * (tile.y + clusterCounts.y * min(slice, clusterCounts.z - 1));
+}
+)";
+
+// The uniform buffer behind LightBlock, bound once to BINDING so every
+// program attached with attach() reads the same lights, plus three texture
+// buffers for clustered shading. Every update() the lights are binned on
+// the CPU into CLUSTERS_X x CLUSTERS_Y screen tiles times CLUSTERS_Z
+// exponential depth slices, so a fragment only loops over the lights whose
+// bounding sphere touches its cluster. The index list is capped at
+// GL_MAX_TEXTURE_BUFFER_SIZE entries; past it the fullest clusters drop
+// their last lights, so the scene's own lights go before any extras.
+class LightBuffer {
+public:
+    static constexpr GLuint BINDING = 0;
+    static constexpr GLuint DATA_UNIT = 1;
+    static constexpr GLuint GRID_UNIT = 2;
+    static constexpr GLuint INDEX_UNIT = 3;
+    static constexpr int CLUSTERS_X = 16;
+    static constexpr int CLUSTERS_Y = 9;
+    static constexpr int CLUSTERS_Z = 24;
+
+    struct Stats {
+        int lights = 0;
+        int indices = 0;
+        int droppedIndices = 0;     // did not fit in the index buffer
+        int busiestCluster = 0;
+        float binMicroseconds = 0.0f;
+    };
+
+    LightBuffer() {
+        std::memset(&uploaded, 0, sizeof(uploaded));
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), &uploaded, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, UBO);
+
+        createTextureBuffer(data, GL_RGBA32F, DATA_UNIT);
+        createTextureBuffer(grid, GL_RG32UI, GRID_UNIT);
+        createTextureBuffer(indices, GL_R32UI, INDEX_UNIT);
+
+        // Only 65536 texels are guaranteed by GL 3.3.
+        GLint texels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+        indexLimit = static_cast<uint32_t>(std::max(texels, 65536));
+    }
+
+    ~LightBuffer() {
+        release();
+    }
+
+    LightBuffer(const LightBuffer&) = delete;
+    LightBuffer& operator=(const LightBuffer&) = delete;
+
+    static void attach(const Shader& shader) {
+        static constexpr UniformName LIGHT_DATA = "lightData";
+        static constexpr UniformName LIGHT_GRID = "lightGrid";
+        static constexpr UniformName LIGHT_INDICES = "lightIndices";
+        shader.bindBlock("LightBlock", BINDING);
+        shader.use();
+        shader.set(shader.uniform<int>(LIGHT_DATA), static_cast<int>(DATA_UNIT));
+        shader.set(shader.uniform<int>(LIGHT_GRID), static_cast<int>(GRID_UNIT));
+        shader.set(shader.uniform<int>(LIGHT_INDICES), static_cast<int>(INDEX_UNIT));
+    }
+
+    // Bins and uploads the lights for this view, then uploads the block if
+    // it differs from what the GPU already has. Returns whether the block
+    // was uploaded.
+    bool update(LightBlock block, const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+        float nearPlane, float farPlane, int viewportWidth, int viewportHeight) {
+        auto start = std::chrono::steady_clock::now();
+        float sliceScale = CLUSTERS_Z / std::log(farPlane / nearPlane);
+        block.clusterCounts = glm::ivec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, static_cast<int>(lights.size()));
+        block.clusterParams = glm::vec4(sliceScale, -std::log(nearPlane) * sliceScale,
+            std::max(viewportWidth, 1) / float(CLUSTERS_X), std::max(viewportHeight, 1) / float(CLUSTERS_Y));
+
+        uint32_t dropped = bin(lights, view, projection, nearPlane, farPlane, sliceScale, block.clusterParams.y);
+
+        lightTexels.clear();
+        for (const Light& light : lights) {
+            lightTexels.push_back(glm::vec4(light.position, light.range));
+            lightTexels.push_back(glm::vec4(light.color, static_cast<float>(light.shadow)));
+            lightTexels.push_back(glm::vec4(light.direction, light.cosCutoff));
+        }
+        upload(data, lightTexels.data(), lightTexels.size() * sizeof(glm::vec4));
+        upload(grid, clusters.data(), clusters.size() * sizeof(Cluster));
+        upload(indices, lightIndices.data(), lightIndices.size() * sizeof(uint32_t));
+        for (TextureBuffer* buffer : { &data, &grid, &indices }) {
+            glActiveTexture(GL_TEXTURE0 + buffer->unit);
+            glBindTexture(GL_TEXTURE_BUFFER, buffer->texture);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        stats.lights = static_cast<int>(lights.size());
+        stats.indices = static_cast<int>(lightIndices.size());
+        stats.droppedIndices = static_cast<int>(dropped);
+        stats.busiestCluster = 0;
+        for (const Cluster& cluster : clusters)
+            stats.busiestCluster = std::max(stats.busiestCluster, static_cast<int>(cluster.count));
+        std::chrono::duration<float, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        stats.binMicroseconds = elapsed.count();
+
+        if (std::memcmp(&block, &uploaded, sizeof(LightBlock)) == 0)
+            return false;
+        uploaded = block;
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &uploaded);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        return true;
+    }
+
+    const Stats& lastStats() const {
+        return stats;
+    }
+
+    // Deletes the buffers; call before the GL context goes away.
+    void release() {
+        if (UBO == 0)
+            return;
+        glDeleteBuffers(1, &UBO);
+        for (TextureBuffer* buffer : { &data, &grid, &indices }) {
+            glDeleteTextures(1, &buffer->texture);
+            glDeleteBuffers(1, &buffer->buffer);
+            buffer->texture = buffer->buffer = 0;
+        }
+        UBO = 0;
+    }
+
+private:
+    struct TextureBuffer {
+        unsigned int buffer = 0;
+        unsigned int texture = 0;
+        GLuint unit = 0;
+    };
+
+    struct Cluster {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // Cluster range one light covers, inclusive.
+    struct Footprint {
+        int x0, x1, y0, y1, z0, z1;
+    };
+
+    unsigned int UBO = 0;
+    uint32_t indexLimit = 65536;
+    LightBlock uploaded;
+    TextureBuffer data, grid, indices;
+    std::vector<glm::vec4> lightTexels;
+    std::vector<Cluster> clusters;
+    std::vector<uint32_t> lightIndices;
+    std::vector<Footprint> footprints;
+    Stats stats;
+
+    static void createTextureBuffer(TextureBuffer& target, GLenum format, GLuint unit) {
+        target.unit = unit;
+        glGenBuffers(1, &target.buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, target.buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glGenTextures(1, &target.texture);
+        glBindTexture(GL_TEXTURE_BUFFER, target.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, target.buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Orphans the buffer; the texture keeps pointing at the same name.
+    static void upload(const TextureBuffer& target, const void* bytes, size_t size) {
+        glBindBuffer(GL_TEXTURE_BUFFER, target.buffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), nullptr, GL_STREAM_DRAW);
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, bytes);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Two passes over the lights: count per cluster, then fill the index
+    // list at each cluster's prefix-summed offset. Returns how many entries
+    // were left out to stay within indexLimit.
+    uint32_t bin(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+        float nearPlane, float farPlane, float sliceScale, float sliceBias) {
+        clusters.assign(CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z, { 0, 0 });
+        footprints.clear();
+        auto slice = [&](float depth) {
+            return std::clamp(static_cast<int>(std::log(depth) * sliceScale + sliceBias), 0, CLUSTERS_Z - 1);
+        };
+
+        for (const Light& light : lights) {
+            glm::vec3 center;
+            float radius;
+            light.boundingSphere(center, radius);
+            glm::vec3 viewCenter = glm::vec3(view * glm::vec4(center, 1.0f));
+            float depth = -viewCenter.z;
+            Footprint footprint = { 0, CLUSTERS_X - 1, 0, CLUSTERS_Y - 1, 0, 0 };
+            if (depth + radius < nearPlane || depth - radius > farPlane) {
+                footprints.push_back({ 0, -1, 0, -1, 0, -1 });
+                continue;
+            }
+            footprint.z0 = slice(std::max(depth - radius, nearPlane));
+            footprint.z1 = slice(std::min(depth + radius, farPlane));
+
+            // A sphere clear of the near plane projects inside the screen
+            // rectangle of its view-space box.
+            if (depth - radius > nearPlane) {
+                glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+                for (int corner = 0; corner < 8; corner++) {
+                    glm::vec3 p = viewCenter + glm::vec3((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius,
+                        (corner & 4) ? radius : -radius);
+                    glm::vec4 clip = projection * glm::vec4(p, 1.0f);
+                    glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                    ndcMin = glm::min(ndcMin, ndc);
+                    ndcMax = glm::max(ndcMax, ndc);
+                }
+                footprint.x0 = std::clamp(static_cast<int>(std::floor((ndcMin.x * 0.5f + 0.5f) * CLUSTERS_X)), 0, CLUSTERS_X);
+                footprint.x1 = std::clamp(static_cast<int>(std::floor((ndcMax.x * 0.5f + 0.5f) * CLUSTERS_X)), -1, CLUSTERS_X - 1);
+                footprint.y0 = std::clamp(static_cast<int>(std::floor((ndcMin.y * 0.5f + 0.5f) * CLUSTERS_Y)), 0, CLUSTERS_Y);
+                footprint.y1 = std::clamp(static_cast<int>(std::floor((ndcMax.y * 0.5f + 0.5f) * CLUSTERS_Y)), -1, CLUSTERS_Y - 1);
+            }
+            footprints.push_back(footprint);
+            forEachCluster(footprint, [&](Cluster& cluster) { cluster.count++; });
+        }
+
+        // When the list would not fit, every cluster keeps at most its first
+        // cap lights, with cap the largest that fits.
+        uint32_t total = 0, cap = 0;
+        for (const Cluster& cluster : clusters) {
+            total += cluster.count;
+            cap = std::max(cap, cluster.count);
+        }
+        if (total > indexLimit) {
+            uint32_t low = 0, high = cap;
+            while (low < high) {
+                uint32_t mid = (low + high + 1) / 2;
+                uint32_t kept = 0;
+                for (const Cluster& cluster : clusters)
+                    kept += std::min(cluster.count, mid);
+                if (kept <= indexLimit)
+                    low = mid;
+                else
+                    high = mid - 1;
+            }
+            cap = low;
+        }
+
+        uint32_t offset = 0;
+        for (Cluster& cluster : clusters) {
+            cluster.first = offset;
+            offset += std::min(cluster.count, cap);
+            cluster.count = 0;
+        }
+        lightIndices.resize(offset);
+        for (uint32_t i = 0; i < footprints.size(); i++) {
+            forEachCluster(footprints[i], [&](Cluster& cluster) {
+                if (cluster.count < cap)
+                    lightIndices[cluster.first + cluster.count++] = i;
+            });
+        }
+        return total - offset;
+    }
+
+    template <typename F>
+    void forEachCluster(const Footprint& footprint, F f) {
+        for (int z = footprint.z0; z <= footprint.z1; z++) {
+            for (int y = footprint.y0; y <= footprint.y1; y++) {
+                for (int x = footprint.x0; x <= footprint.x1; x++)
+                    f(clusters[x + CLUSTERS_X * (y + CLUSTERS_Y * z)]);
+            }
+        }
+    }
+};
+
+#endif
@@ -8,12 +8,21 @@
 #include "model.h"
 #include "camera.h"
 #include "robot.h"
+#include "asset_loader.h"
+#include "exhibit_streamer.h"
+#include "light_buffer.h"
+#include "shadow_atlas.h"
+#include "transform_buffer.h"
+#include "dynamic_resolution.h"
+#include "debug_draw.h"
+#include "gpu_profiler.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include <Windows.h>         
 #include <filesystem>        
 #include <string>            
+#include <chrono>
 
 std::string getExecutableDir() {
     char buffer[MAX_PATH];    GetModuleFileNameA(NULL, buffer, MAX_PATH);
@@ -40,102 +49,133 @@ bool isPanning = false;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 glm::mat4 projection;
+//Sahne hedefi pencere boyutunu geri çağırmadan alır
+DynamicResolution* sceneTarget = nullptr;
 
 bool autoMode = false; 
 
+//LOD ayarları
+bool lodEnabled = true;
+float lodPixelError = 1.0f;
+size_t drawnTriangles = 0;
+
+//Instancing testi: robot gövdesinin kopyaları tek çağrıda çizilir
+int crowdSize = 0;
+int crowdVisible = 0;
+
 float armAngle = 0.0f; 
 int scannedModelIndex = -1;
 
 
 //Shader kaynakları
 const char* vertexShaderSource = R"(
-#version 330 core
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in uint aTransform;
+layout(location = 4) in vec4 aInstanceColor;
+layout(location = 5) in vec3 aPosOffset;
+layout(location = 6) in vec3 aPosScale;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
+out vec3 ObjectColor;
+out float ViewDepth;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    vec3 position = aPosOffset + aPos * aPosScale;
+    FragPos = vec3(objectTransform(aTransform) * vec4(position, 1.0));
+    // Normal matrisi CPU'da nesne başına bir kez hesaplanır
+    Normal = objectNormalMatrix(aTransform) * aNormal;
     TexCoord = aTexCoord;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    ObjectColor = aInstanceColor.rgb;
+    vec4 viewPos = view * vec4(FragPos, 1.0);
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
 }
 )";
 
 
+//Örtücü ön geçişi: yalnızca derinlik, düşük çözünürlükte
+const char* depthVertexShaderSource = R"(
+layout(location = 0) in vec3 aPos;
+layout(location = 3) in uint aTransform;
+layout(location = 5) in vec3 aPosOffset;
+layout(location = 6) in vec3 aPosScale;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    vec3 position = aPosOffset + aPos * aPosScale;
+    gl_Position = projection * view * objectTransform(aTransform) * vec4(position, 1.0);
+}
+)";
+
+const char* depthFragmentShaderSource = R"(
+void main()
+{
+}
+)";
+
+
+//Işık verisi LIGHT_BLOCK_GLSL, gölge atlası SHADOW_ATLAS_GLSL ile #version satırından sonra eklenir
 const char* fragmentShaderSource = R"(
-#version 330 core
 out vec4 FragColor;
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
+in vec3 ObjectColor;
+in float ViewDepth;
 
 uniform vec3 viewPos;
-uniform vec3 lightColor;
-uniform vec3 objectColor;
 uniform sampler2D texture_diffuse1;
-uniform bool useTexture;
-
-uniform vec3 spotLights[5];
-uniform vec3 spotDirs[5];
-uniform float intensities[5];
-
-uniform vec3 pointLights[2];
-uniform float pointIntensities[2];
-uniform vec3 pointColors[2];
-
-uniform vec3 ceilingPos;
-uniform vec3 ceilingColor;
-uniform float ceilingIntensity;
-
-
-const float cutOff = cos(radians(20.0)); // Spotlight açısı
 
 void main()
 {
+#ifdef TEXTURED
+    vec4 baseColor = texture(texture_diffuse1, TexCoord);
+#else
+    vec4 baseColor = vec4(ObjectColor, 1.0);
+#endif
+
     vec3 norm = normalize(Normal);
     vec3 result = vec3(0.0);
 
 
-    for (int i = 0; i < 5; ++i)
+    //Yalnızca bu kümeye düşen spot ve nokta ışıkları dolaşılır
+    uvec2 cluster = texelFetch(lightGrid, lightCluster(ViewDepth)).xy;
+    for (uint i = 0u; i < cluster.y; ++i)
     {
-        vec3 lightDir = normalize(spotLights[i] - FragPos);
-        float theta = dot(lightDir, normalize(-spotDirs[i]));
-
-        if (theta > cutOff) {
-            float diff = max(dot(norm, lightDir), 0.0);
-            result += diff * intensities[i] * lightColor;
-        }
-
-    vec3 ceilingDir = normalize(ceilingPos - FragPos);
-    float ceilingDiff = max(dot(norm, ceilingDir), 0.0);
-    vec3 ceilingLight = ceilingDiff * ceilingIntensity * ceilingColor;
-    result += ceilingLight;
-
-    }
+        int light = int(texelFetch(lightIndices, int(cluster.x + i)).r) * 3;
+        vec4 positionRange = texelFetch(lightData, light);
+        vec3 toLight = positionRange.xyz - FragPos;
+        float lightDistance = length(toLight);
+        if (lightDistance > positionRange.w)
+            continue;
+
+        vec3 lightDir = toLight / lightDistance;
+        vec4 directionCutoff = texelFetch(lightData, light + 2);
+        if (dot(lightDir, -directionCutoff.xyz) <= directionCutoff.w)
+            continue;
 
-    for (int i = 0; i < 2; ++i)
-    {
-        vec3 lightDir = normalize(pointLights[i] - FragPos);
         float diff = max(dot(norm, lightDir), 0.0);
-        result += diff * pointIntensities[i] * pointColors[i];
+        vec4 colorShadow = texelFetch(lightData, light + 1);
+        result += diff * colorShadow.rgb * shadowFactor(int(colorShadow.w), FragPos, norm);
     }
 
-    result += 0.15 * lightColor;
+    vec3 ceilingDir = normalize(ceilingPosition.xyz - FragPos);
+    float ceilingDiff = max(dot(norm, ceilingDir), 0.0);
+    result += ceilingDiff * ceilingPosition.w * ceilingColor.rgb * shadowFactor(int(ceilingColor.w), FragPos, norm);
 
-    vec4 baseColor = useTexture
-        ? texture(texture_diffuse1, TexCoord)
-        : vec4(objectColor, 1.0);
+    result += 0.15 * lightColor.rgb;
 
     FragColor = vec4(result, 1.0) * baseColor;
 }
@@ -145,7 +185,8 @@ void main()
 //Callback fonksiyonları
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    if (sceneTarget)
+        sceneTarget->resize(width, height);
     projection = glm::perspective(glm::radians(camera.Zoom), (float)width / (float)height, 0.1f, 100.0f);
 }
 
@@ -280,6 +321,24 @@ std::vector<std::string> modelInfoTexts = {
 
 };
 
+//Oda parçaları: satır başına konum + normal, 6 float
+std::unique_ptr<Model> makeRoomModel(const float* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+{
+    MeshData mesh;
+    for (size_t i = 0; i < vertexCount; ++i) {
+        Vertex vertex = {};
+        vertex.Position = glm::vec3(vertices[i * 6], vertices[i * 6 + 1], vertices[i * 6 + 2]);
+        vertex.Normal = glm::vec3(vertices[i * 6 + 3], vertices[i * 6 + 4], vertices[i * 6 + 5]);
+        mesh.vertices.push_back(vertex);
+    }
+    mesh.indices.assign(indices, indices + indexCount);
+    Mesh::computeBounds(mesh.vertices, mesh.boundsMin, mesh.boundsMax);
+
+    ModelData data;
+    data.meshes.push_back(std::move(mesh));
+    return std::make_unique<Model>(std::move(data));
+}
+
 enum CameraMode { Free, Follow, Scanner };
 CameraMode camMode = Free;
 CameraMode prevCamMode = Free;
@@ -287,7 +346,7 @@ CameraMode prevCamMode = Free;
 
 int main()
 {
-
+    auto startupBegin = std::chrono::steady_clock::now();
 
 
     glfwInit();
@@ -319,6 +378,7 @@ int main()
         std::cout << "Failed to initialize GLAD\n";
         return -1;
     }
+    GLExt::init((GLADloadproc)glfwGetProcAddress);
 
 
     glEnable(GL_DEPTH_TEST);
@@ -332,7 +392,7 @@ int main()
     PointLight ceilingLight = {
         glm::vec3(0.0f, 5.0f, 0.0f),
         glm::vec3(1.0f, 1.0f, 1.0f),
-        0.1f
+        0.5f
     };
 
     static const ImWchar turkish_range[] = {
@@ -423,23 +483,100 @@ int main()
 
     glm::vec3 spotlightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
 
-    Shader shader(vertexShaderSource, fragmentShaderSource);
+    //Kamera uniformları her varyanta karede bir kez yazılır; konumları bağlamada bir kez çözülür
+    glm::mat4 view = camera.GetViewMatrix();
+    auto setCamera = [&](const Shader& variant) {
+        variant.use();
+        variant.set(variant.camera.view, view);
+        variant.set(variant.camera.projection, projection);
+        variant.set(variant.camera.viewPos, camera.Position);
+    };
+
+    //Işıklar bir UBO ve doku tamponlarında; her karede ekran kümelerine ayrılır
+    LightBuffer lightBuffer;
+    std::vector<Light> sceneLights;
+    int extraSpotlights = 0;
+
+    //Statik gölgeler atlasta saklanır; yalnızca robot her karede üstüne çizilir
+    ShadowAtlas shadowAtlas;
+    RenderQueue shadowQueue;
+    std::vector<const Model*> shadowCasters;
+    bool shadowsEnabled = true;
+
+    //Derlenen programlar sürücüye özel ikili olarak saklanır; sonraki açılışlarda derleme atlanır
+    ProgramCache::directory = getExecutableDir() + "/shader_cache";
+
+    //3B sahne ekran dışı bir hedefe çizilir; çözünürlüğü GPU süresine göre ayarlanıp pencereye büyütülür
+    DynamicResolution dynamicResolution;
+    dynamicResolution.resize(w, h);
+    sceneTarget = &dynamicResolution;
+
+    //Doku ve ışıklandırma derleme anında seçilir; her birleşim ilk kullanıldığında derlenir
+    ShaderVariants sceneShaders(std::string(TRANSFORM_BUFFER_GLSL) + vertexShaderSource,
+        std::string(LIGHT_BLOCK_GLSL) + SHADOW_ATLAS_GLSL + fragmentShaderSource, SHADER_TEXTURED,
+        [&](const Shader& variant) {
+            TransformBuffer::attach(variant);
+            LightBuffer::attach(variant);
+            ShadowAtlas::attach(variant);
+            setCamera(variant);
+        });
+    //Bilinen varyantlar birlikte başlatılır; sürücü destekliyorsa arka planda derlenir
+    sceneShaders.prepare({ SHADER_NONE, SHADER_TEXTURED });
+
+    RenderQueue renderQueue;
+
+    //Geçişlerin GPU süreleri birkaç kare sonra okunur; "Performance" panelinde gösterilir
+    //Ölçüm kapalıyken kuyruk geçişleri ayırmaz, tüm kare tek sıralamayla çizilir
+    GpuProfiler profiler;
+    renderQueue.profiler = &profiler;
+    std::string profileExportStatus;
+
+    //Durağan örtücüler (oda, eserler) küçük bir derinlik hedefine çizilir; arkalarında kalanlar elenir
+    ShaderVariants depthShaders(std::string(TRANSFORM_BUFFER_GLSL) + depthVertexShaderSource, depthFragmentShaderSource, 0,
+        TransformBuffer::attach);
+    const Shader& depthShader = depthShaders.get(0);
+    RenderQueue occluderQueue;
+    OcclusionCuller occlusion;
+    uint64_t occluderVersion = 0;
+    renderQueue.occlusion = &occlusion;
+
+    //Kalabalık testindeki her kopyanın kendi dönüşüm yuvası vardır
+    std::vector<TransformSlot> crowdSlots;
+    int crowdLimit = 10000;
+    std::vector<InstanceData> crowd;
+    FrustumCuller crowdCuller;
 
     std::string baseDir = getExecutableDir();
     std::string modelDir = baseDir + "/../../assets/models/";
 
-    Model model1(modelDir + "model1.obj");
-    Model model2(modelDir + "model2.obj");
-    Model model3(modelDir + "model3.obj");
-    Model model4(modelDir + "model4.obj");
-    Model model5(modelDir + "model5.obj");
+    // Modeller arka planda yüklenir; oda hemen çizilir, eserler hazır oldukça eklenir.
+    AssetLoader assetLoader;
+
+    // Eserler kamera ya da robot yaklaştıkça yüklenir, bütçe aşılınca uzaktakiler bırakılır.
+    ExhibitStreamer streamer(assetLoader);
+    std::vector<glm::vec3> exhibitPositions = {
+        glm::vec3(-6.0f, 1.4f, 0.0f),
+        glm::vec3(-3.0f, 0.4f, -0.8f),
+        glm::vec3(-0.19f, 1.0f, 0.0f),
+        glm::vec3(3.0f, 0.4f, 0.0f),
+        glm::vec3(6.0f, 1.15f, 0.3f)
+    };
+    std::vector<float> exhibitScales = { 0.7f, 1.0f, 1.0f, 0.6f, 0.45f };
+    for (int i = 0; i < 5; ++i) {
+        glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), exhibitPositions[i]);
+        modelMat = glm::scale(modelMat, glm::vec3(exhibitScales[i]));
+        streamer.add(modelDir + "model" + std::to_string(i + 1) + ".obj", modelMat);
+    }
+
+    Robot robot(glm::vec3(-5.0f, 0.0f, 2.5f));
+    assetLoader.loadModel(modelDir + "robot_body.obj",
+        [&robot](std::unique_ptr<Model> model) { robot.body = std::move(model); });
+    assetLoader.loadModel(modelDir + "robot_arm.obj",
+        [&robot](std::unique_ptr<Model> model) { robot.arm = std::move(model); });
+
+    bool firstFrameLogged = false;
+    bool fullyLoadedLogged = false;
 
-    Robot robot(
-        modelDir + "robot_body.obj",
-        modelDir + "robot_arm.obj",
-        glm::vec3(-5.0f, 0.0f, 2.5f)
-    );
-    
 
     std::vector<glm::vec3> objectPositions = {
         glm::vec3(-6.0f, 0.0f, 0.0f),
@@ -518,44 +655,13 @@ int main()
         8,9,10, 8,10,11
     };
 
-    unsigned int rayVAO, rayVBO;
-    glGenVertexArrays(1, &rayVAO);
-    glGenBuffers(1, &rayVBO);
-
-
-    unsigned int VAO, VBO, EBO, wallVAO, wallVBO, wallEBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(groundVertices), groundVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(groundIndices), groundIndices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    //Tarama ışını gibi her karede değişen çizgiler halka tampona yazılır
+    DebugDraw debugDraw;
+    bool showBounds = false;
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    ;
-
-    glGenVertexArrays(1, &wallVAO);
-    glGenBuffers(1, &wallVBO);
-    glGenBuffers(1, &wallEBO);
-
-    glBindVertexArray(wallVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, wallVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(wallVertices), wallVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wallEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(wallIndices), wallIndices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    //Zemin ve duvarlar da modellerle aynı ortak geometri tamponunda tutulur
+    std::unique_ptr<Model> floorModel = makeRoomModel(groundVertices, 4, groundIndices, 6);
+    std::unique_ptr<Model> wallModel = makeRoomModel(wallVertices, 20, wallIndices, 18);
 
 
     while (!glfwWindowShouldClose(window))
@@ -563,9 +669,10 @@ int main()
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        profiler.beginFrame();
 
-        glClearColor(0.7f, 0.7f, 0.75f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        streamer.update({ camera.Position, robot.position });
+        assetLoader.pump();
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -617,7 +724,7 @@ int main()
             ImGui::SliderFloat("##L2Int", &pointIntensities[1], 0.0f, 3.0f); ImGui::NextColumn();
 
             ImGui::Text("Main Light Intensity"); ImGui::NextColumn();
-            ImGui::SliderFloat("##CeilingInt", &ceilingLight.intensity, 0.0f, 0.5f); ImGui::NextColumn();
+            ImGui::SliderFloat("##CeilingInt", &ceilingLight.intensity, 0.0f, 2.5f); ImGui::NextColumn();
 
             ImGui::Text("Light 1 Color"); ImGui::NextColumn();
             ImGui::ColorEdit3("##L1Col", glm::value_ptr(pointColors[0]), ImGuiColorEditFlags_NoInputs); ImGui::NextColumn();
@@ -629,12 +736,123 @@ int main()
             ImGui::ColorEdit3("##CeilingCol", glm::value_ptr(ceilingLight.color), ImGuiColorEditFlags_NoInputs); ImGui::NextColumn();
 
             ImGui::Columns(1);
+
+            ImGui::SliderInt("Extra Spotlights", &extraSpotlights, 0, 500);
+            const LightBuffer::Stats& lightStats = lightBuffer.lastStats();
+            ImGui::Text("Lights: %d, cluster entries: %d (max %d per cluster)", lightStats.lights, lightStats.indices,
+                lightStats.busiestCluster);
+            if (lightStats.droppedIndices > 0)
+                ImGui::Text("Cluster entries dropped: %d (index buffer full)", lightStats.droppedIndices);
+            ImGui::Text("Light binning: %.1f us", lightStats.binMicroseconds);
+            ImGui::Checkbox("Shadows", &shadowsEnabled);
+            const ShadowAtlas::Stats& shadowStats = shadowAtlas.lastStats();
+            ImGui::Text("Shadow maps: %d static redrawn, %d cached", shadowStats.staticRendered, shadowStats.staticSkipped);
+            ImGui::Text("Robot shadow passes: %d, tiles restored: %d", shadowStats.dynamicRendered, shadowStats.tilesCopied);
         }
 
         if (ImGui::CollapsingHeader("Camera Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Combo("Camera Mode", (int*)&camMode, "Free\0Follow\0Scanner\0");
         }
 
+        if (ImGui::CollapsingHeader("Dynamic Resolution")) {
+            ImGui::Checkbox("Adapt Resolution", &dynamicResolution.enabled);
+            ImGui::SliderFloat("GPU Budget (ms)", &dynamicResolution.budgetMilliseconds, 4.0f, 33.0f);
+            ImGui::SliderFloat("Min Scale", &dynamicResolution.minScale, 0.25f, 1.0f);
+            ImGui::SliderFloat("Sharpness", &dynamicResolution.sharpness, 0.0f, 1.0f);
+            ImGui::Text("Scale %.0f%%: %dx%d, scene GPU %.2f ms", dynamicResolution.scale() * 100.0f,
+                dynamicResolution.renderWidth(), dynamicResolution.renderHeight(), dynamicResolution.lastGpuMilliseconds());
+        }
+
+        if (ImGui::CollapsingHeader("Level of Detail")) {
+            ImGui::Checkbox("Enable LOD", &lodEnabled);
+            ImGui::SliderFloat("Max Pixel Error", &lodPixelError, 0.25f, 8.0f);
+            ImGui::Text("Exhibit triangles drawn: %d", (int)drawnTriangles);
+        }
+
+        if (ImGui::CollapsingHeader("Render Queue")) {
+            const RenderStats& stats = renderQueue.lastStats();
+            if (GLExt::multiDrawIndirect)
+                ImGui::Checkbox("Multi-Draw Indirect", &renderQueue.useMultiDrawIndirect);
+            else
+                ImGui::TextDisabled("Multi-draw indirect needs GL 4.3");
+            ImGui::Text("Draw calls: %d (%d batches, %d instances)", stats.draws, stats.commands, stats.instances);
+            ImGui::Text("Program binds: %d, VAO binds: %d", stats.programBinds, stats.vaoBinds);
+            ImGui::Text("Texture binds: %d, shader variants: %d", stats.textureBinds, (int)sceneShaders.compiledCount());
+            ImGui::Text("Redundant changes skipped: %d", stats.skipped);
+            ImGui::Text("Transforms: %d objects, %d uploaded", (int)TransformBuffer::instance().size(),
+                TransformBuffer::instance().lastUpdated());
+            ImGui::Text("Visible %d, culled %d in %.1f us", stats.visible, stats.culled, stats.cullMicroseconds);
+            ImGui::Checkbox("Occlusion Culling", &occlusion.enabled);
+            ImGui::Text("Occluded %d: %d triangles, ~%.0f pixels saved", stats.occluded, stats.occludedTriangles,
+                stats.occludedPixels);
+        }
+
+        if (ImGui::CollapsingHeader("Debug Draw")) {
+            ImGui::Checkbox("Show Bounds", &showBounds);
+            const DebugDraw::Stats& debugStats = debugDraw.lastStats();
+            const StreamBuffer::Stats& streamStats = debugDraw.buffer().stats();
+            ImGui::Text("%d line vertices, %d dropped", debugStats.vertices, debugStats.dropped);
+            ImGui::Text("%s ring buffer: %d fence waits, %d orphans",
+                debugDraw.buffer().isPersistent() ? "Persistent" : "Mapped", streamStats.waits, streamStats.orphans);
+        }
+
+        if (ImGui::CollapsingHeader("Instancing")) {
+            ImGui::SliderInt("Robot Copies", &crowdSize, 0, crowdLimit);
+            if (robot.body)
+                ImGui::Text("%d visible, %d triangles in one draw per mesh", crowdVisible,
+                    (int)(crowdVisible * robot.body->drawnTriangles()));
+        }
+
+        if (ImGui::CollapsingHeader("Streaming")) {
+            static int budgetMB = (int)(streamer.budgetBytes >> 20);
+            ImGui::SliderFloat("Load Radius", &streamer.loadRadius, 1.0f, 40.0f);
+            if (ImGui::SliderInt("Budget (MB)", &budgetMB, 1, 1024))
+                streamer.budgetBytes = (size_t)budgetMB << 20;
+            ImGui::Text("Resident %d, loading %d, %.1f MB",
+                (int)streamer.countIn(ExhibitStreamer::State::Resident),
+                (int)streamer.countIn(ExhibitStreamer::State::Loading),
+                streamer.residentBytes() / (1024.0f * 1024.0f));
+        }
+
+        if (ImGui::CollapsingHeader("Texture Memory")) {
+            std::vector<TextureManager::Info> textureStats = TextureManager::instance().stats();
+            ImGui::Text("%d textures, %.1f MB", (int)textureStats.size(),
+                TextureManager::instance().totalBytes() / (1024.0f * 1024.0f));
+            for (const auto& tex : textureStats) {
+                std::string name = std::filesystem::path(tex.path).filename().string();
+                ImGui::Text("%s", name.c_str());
+                ImGui::TextDisabled("  %dx%d %s, %.0f KB, %d users", tex.width, tex.height, tex.format,
+                    tex.bytes / 1024.0f, tex.refs);
+            }
+        }
+
+        ImGui::End();
+
+        //Performans paneli kontrol panelinin solunda açılır
+        ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 270, 10), ImGuiCond_Once, ImVec2(1.0f, 0.0f));
+        ImGui::SetNextWindowSize(ImVec2(310, 400), ImGuiCond_Once);
+        ImGui::Begin("Performance");
+        ImGui::Checkbox("GPU Timing", &profiler.enabled);
+        ImGui::SameLine();
+        if (ImGui::Button("Export CSV")) {
+            std::string path = getExecutableDir() + "/gpu_profile.csv";
+            profileExportStatus = profiler.exportCsv(path) ? "Saved " + path : "Could not write " + path;
+        }
+        if (!profileExportStatus.empty())
+            ImGui::TextWrapped("%s", profileExportStatus.c_str());
+        ImGui::Text("Frame %.2f ms, dropped GPU frames: %d", deltaTime * 1000.0f, profiler.droppedFrames());
+        if (!GLExt::debugGroups)
+            ImGui::TextDisabled("Debug groups need GL 4.3 or KHR_debug");
+        const std::vector<GpuProfiler::Section>& gpuSections = profiler.sections();
+        for (size_t i = 0; i < gpuSections.size(); ++i) {
+            const GpuProfiler::Section& section = gpuSections[i];
+            ImGui::Text("%*s%s: %.2f ms (avg %.2f)", section.depth * 2, "", section.name.c_str(), section.milliseconds,
+                section.average);
+            ImGui::PushID((int)i);
+            ImGui::PlotLines("##history", section.history, GpuProfiler::HISTORY, profiler.historyStart(), nullptr,
+                0.0f, FLT_MAX, ImVec2(-1.0f, 30.0f));
+            ImGui::PopID();
+        }
         ImGui::End();
 
         if (camMode != prevCamMode) {
@@ -771,12 +989,6 @@ int main()
             }
         }
 
-        shader.use();
-
-        shader.setVec3("ceilingPos", ceilingLight.position);
-        shader.setVec3("ceilingColor", ceilingLight.color);
-        shader.setFloat("ceilingIntensity", ceilingLight.intensity);
-
         static float smoothArmAngle = 0.0f;
         float dampingSpeed = 8.0f;
         smoothArmAngle = glm::mix(smoothArmAngle, armAngle, deltaTime * dampingSpeed);
@@ -797,17 +1009,6 @@ int main()
 
         glm::vec3 rayEnd = rayStart + rayDir * 5.5f;
 
-        float rayVertices[] = {
-            rayStart.x, rayStart.y, rayStart.z,
-            rayEnd.x, rayEnd.y, rayEnd.z
-        };
-
-        glBindVertexArray(rayVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, rayVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(rayVertices), rayVertices, GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
         //Spotlight sistemi
         std::vector<float> intensities(5, 0.2f);
 
@@ -827,18 +1028,33 @@ int main()
             }
         }
 
-        for (int i = 0; i < 5; ++i) {
-            std::string posName = "spotLights[" + std::to_string(i) + "]";
-            std::string dirName = "spotDirs[" + std::to_string(i) + "]";
-            std::string intensityName = "intensities[" + std::to_string(i) + "]";
-
-            glUniform3fv(glGetUniformLocation(shader.ID, posName.c_str()), 1, glm::value_ptr(spotlightPositions[i]));
-            glUniform3fv(glGetUniformLocation(shader.ID, dirName.c_str()), 1, glm::value_ptr(spotlightDirection));
-            glUniform1f(glGetUniformLocation(shader.ID, intensityName.c_str()), intensities[i]);
+        LightBlock lightBlock{};
+        lightBlock.ceilingPosition = glm::vec4(ceilingLight.position, ceilingLight.intensity);
+        //Tavan ışığının gölgesi atlasın son görünümündedir
+        const int ceilingShadow = ShadowAtlas::MAX_VIEWS - 1;
+        lightBlock.ceilingColor = glm::vec4(ceilingLight.color, shadowsEnabled ? ceilingShadow : -1);
+        lightBlock.lightColor = glm::vec4(1.0f);
+
+        sceneLights.clear();
+        for (size_t i = 0; i < spotlightPositions.size(); ++i) {
+            sceneLights.push_back(Light::spot(spotlightPositions[i], spotlightDirection, glm::vec3(lightBlock.lightColor),
+                intensities[i], 20.0f, 6.0f));
+            if (shadowsEnabled && (int)i < ceilingShadow)
+                sceneLights.back().shadow = (int)i;
+        }
+        for (size_t i = 0; i < pointLights.size(); ++i)
+            sceneLights.push_back(Light::point(pointLights[i], pointColors[i], pointIntensities[i], 25.0f));
+
+        //Ek spotlar tavan altında, oda sınırları (x: -10..10, z: -5..5) içinde bir ızgaraya dizilir
+        int extraSide = (int)std::ceil(std::sqrt((float)extraSpotlights));
+        for (int i = 0; i < extraSpotlights; ++i) {
+            float u = extraSide > 1 ? (float)(i % extraSide) / (extraSide - 1) : 0.5f;
+            float v = extraSide > 1 ? (float)(i / extraSide) / (extraSide - 1) : 0.5f;
+            glm::vec3 position(-9.0f + 18.0f * u, 3.0f, -4.5f + 9.0f * v);
+            glm::vec3 color(0.5f + 0.5f * std::sin(i * 1.3f), 0.5f + 0.5f * std::sin(i * 2.1f + 2.0f),
+                0.5f + 0.5f * std::sin(i * 0.7f + 4.0f));
+            sceneLights.push_back(Light::spot(position, spotlightDirection, color, 0.3f, 15.0f, 4.0f));
         }
-
-        glUniform3fv(glGetUniformLocation(shader.ID, "viewPos"), 1, glm::value_ptr(camera.Position));
-        glUniform3fv(glGetUniformLocation(shader.ID, "lightColor"), 1, glm::value_ptr(glm::vec3(1.0f)));
 
         if (camMode == Follow) {
             camera.SetBehindRobot(robot.position, robot.rotationY, deltaTime);
@@ -852,91 +1068,230 @@ int main()
 
         }
 
-        glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
-
-        std::vector<std::pair<Model*, glm::vec3>> models = {
-        { &model1, glm::vec3(-6.0f, 1.4f, 0.0f) },   
-        { &model2, glm::vec3(-3.0f,  0.4f, -0.8f) },   
-        { &model3, glm::vec3(-0.19f,  1.0f, 0.0f) },   
-        { &model4, glm::vec3(3.0f,  0.4f, 0.0f) },  
-        { &model5, glm::vec3(6.0f,  1.15f, 0.3f) }    
-        };
-
-        shader.setMat4("model", glm::mat4(1.0f));
-        glUniform1i(glGetUniformLocation(shader.ID, "useTexture"), false);
-        glUniform3f(glGetUniformLocation(shader.ID, "objectColor"), 0.6f, 0.6f, 0.6f);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        shader.setMat4("model", glm::mat4(1.0f));
-        glUniform1i(glGetUniformLocation(shader.ID, "useTexture"), false);
-        glUniform3f(glGetUniformLocation(shader.ID, "objectColor"), 0.95f, 0.9f, 0.85f);
-        glBindVertexArray(wallVAO);
-        glDrawElements(GL_TRIANGLES, 30, GL_UNSIGNED_INT, 0);
+        view = camera.GetViewMatrix();
+        sceneShaders.poll();
+        sceneShaders.forEach(setCamera);
+
+        glfwGetFramebufferSize(window, &w, &h);
+        drawnTriangles = 0;
+
+        //Tüm opak çizimler kuyruğa eklenir, her geçiş kendi içinde durum değişimine göre sıralanır
+        renderQueue.beginPass("Room");
+        floorModel->submit(renderQueue, sceneShaders, TransformBuffer::IDENTITY, glm::vec3(0.6f, 0.6f, 0.6f), false);
+        wallModel->submit(renderQueue, sceneShaders, TransformBuffer::IDENTITY, glm::vec3(0.95f, 0.9f, 0.85f), false);
+        floorModel->submit(occluderQueue, depthShaders, TransformBuffer::IDENTITY, glm::vec3(1.0f), false);
+        wallModel->submit(occluderQueue, depthShaders, TransformBuffer::IDENTITY, glm::vec3(1.0f), false);
+
+        renderQueue.beginPass("Exhibits");
+        for (size_t i = 0; i < streamer.count(); ++i) {
+            const ExhibitStreamer::Exhibit& exhibit = streamer.exhibit(i);
+            Model* model = exhibit.model.get();
+            if (!model) {
+                //Yüklenene kadar sınır kutusu çizilir
+                streamer.submitPlaceholder(renderQueue, sceneShaders, i);
+                continue;
+            }
+            const glm::mat4& modelMat = exhibit.transform;
 
-        for (int i = 0; i < models.size(); ++i) {
-            Model* model = models[i].first;
-            glm::vec3 pos = models[i].second;
-            glm::mat4 modelMat = glm::mat4(1.0f);
-            modelMat = glm::translate(modelMat, pos);
+            model->selectLod(modelMat, camera.Position, projection, (float)h, lodEnabled ? lodPixelError : 0.0f);
+            drawnTriangles += model->drawnTriangles();
+            model->submit(renderQueue, sceneShaders, exhibit.slot.index());
+            model->submit(occluderQueue, depthShaders, exhibit.slot.index(), glm::vec3(1.0f), false);
+        }
 
-            if (i == 0) { 
-                modelMat = glm::scale(modelMat, glm::vec3(0.7f));
-            }
-            else if (i == 1) { 
-                modelMat = glm::scale(modelMat, glm::vec3(1.0f));
-            }
-            else if (i == 2) { 
-                modelMat = glm::scale(modelMat, glm::vec3(1.0f));
+        if (armAngle >= 60.0f)
+            debugDraw.line(rayStart, rayEnd, glm::vec3(1.0f, 0.0f, 0.0f));
+
+        //Gövde LOD'u instancing testiyle paylaşıldığı için her karede yeniden seçilir
+        if (robot.body)
+            robot.body->selectLod(robot.bodyTransform(), camera.Position, projection, (float)h, 0.0f);
+        renderQueue.beginPass("Robot");
+        //Robot hareket ettiği için örtücü değildir; bir kare gecikmeli derinlikte yanlış nesneleri gizlerdi
+        robot.submit(renderQueue, sceneShaders, armAngle);
+
+        crowdVisible = 0;
+        crowd.clear();
+        //Dönüşüm tamponu GL_MAX_TEXTURE_BUFFER_SIZE ile sınırlı; kopyalar kalan yuvalara sığdırılır
+        TransformBuffer& transforms = TransformBuffer::instance();
+        size_t otherSlots = transforms.size() - crowdSlots.size();
+        crowdLimit = otherSlots < transforms.maxSlots() ? (int)std::min<size_t>(10000, transforms.maxSlots() - otherSlots) : 0;
+        crowdSize = std::min(crowdSize, crowdLimit);
+        crowdSlots.resize(robot.body ? crowdSize : 0);
+        if (!crowdSlots.empty()) {
+            //Kopyalar odanın içine (x: -9.5..9.5, z: -4.5..4.5) odayla aynı en-boy oranında bir ızgaraya sığdırılır
+            int columns = (int)std::ceil(std::sqrt(2.0f * crowdSize));
+            int rows = (crowdSize + columns - 1) / columns;
+            float spacing = std::min(0.6f, std::min(19.0f / columns, 9.0f / rows));
+            crowdCuller.clear();
+            for (int i = 0; i < crowdSize; ++i) {
+                glm::vec3 pos((i % columns - (columns - 1) * 0.5f) * spacing, 0.6f, (i / columns - (rows - 1) * 0.5f) * spacing);
+                glm::mat4 crowdMat = glm::scale(glm::translate(glm::mat4(1.0f), pos), glm::vec3(0.5f));
+                crowdSlots[i].set(crowdMat);
+                crowdCuller.add(crowdMat, robot.body->boundsMin, robot.body->boundsMax, robot.body->boundsRadius);
             }
-            else if (i == 3) { 
-                modelMat = glm::scale(modelMat, glm::vec3(0.6f));
+            //Görüş alanı dışındaki kopyalar yüklenmeden elenir
+            crowdCuller.cull(Frustum::fromMatrix(projection * view));
+            for (int i = 0; i < crowdSize; ++i) {
+                if (crowdCuller.visible(i))
+                    crowd.push_back({ crowdSlots[i].index(), glm::vec4(0.6f, 0.6f, 0.6f, 1.0f) });
             }
-            else if (i == 4) {
-                modelMat = glm::scale(modelMat, glm::vec3(0.45f));
-            }
-
-            shader.setMat4("model", modelMat);
-            glUniform1i(glGetUniformLocation(shader.ID, "useTexture"), true);
-            glUniform3f(glGetUniformLocation(shader.ID, "objectColor"), 1.0f, 1.0f, 1.0f);
-            model->Draw(shader);
+            crowdVisible = (int)crowd.size();
+            if (crowdVisible > 0)
+                robot.body->selectLod(TransformBuffer::instance().transform(crowd[crowdVisible / 2].transform),
+                    camera.Position, projection, (float)h, lodEnabled ? lodPixelError : 0.0f);
         }
 
-        if (armAngle >= 60.0f) {
-            glUseProgram(shader.ID);
-            glm::mat4 rayModel = glm::mat4(1.0f);
-            shader.setMat4("model", rayModel);
-            glUniform1i(glGetUniformLocation(shader.ID, "useTexture"), false);
-            glUniform3f(glGetUniformLocation(shader.ID, "objectColor"), 1.0f, 0.0f, 0.0f);
+        //Yalnızca bu karede hareket eden nesnelerin matrisleri yüklenir
+        TransformBuffer::instance().upload();
 
-            glBindVertexArray(rayVAO);
-            glDrawArrays(GL_LINES, 0, 2);
+        //GPU süresi ölçülen kısım buradan başlar; ölçek bir önceki ölçümlere göre seçilir
+        dynamicResolution.begin();
+        glClearColor(0.7f, 0.7f, 0.75f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        //Işıklar çizilen çözünürlükteki kümelere ayrılır
+        lightBuffer.update(lightBlock, sceneLights, view, projection, 0.1f, 100.0f,
+            dynamicResolution.renderWidth(), dynamicResolution.renderHeight());
+
+        //Yüklenen, değişen ya da boşaltılan eserler yalnızca onları gören gölge haritalarını bozar
+        shadowCasters.resize(streamer.count(), nullptr);
+        for (size_t i = 0; i < streamer.count(); ++i) {
+            const ExhibitStreamer::Exhibit& exhibit = streamer.exhibit(i);
+            if (shadowCasters[i] != exhibit.model.get()) {
+                shadowCasters[i] = exhibit.model.get();
+                glm::vec3 center;
+                float radius;
+                exhibit.boundingSphere(center, radius);
+                shadowAtlas.invalidate(center, radius);
+            }
         }
 
-        for (int i = 0; i < 2; ++i) {
-            std::string lightName = "pointLights[" + std::to_string(i) + "]";
-            glUniform3fv(glGetUniformLocation(shader.ID, lightName.c_str()), 1, glm::value_ptr(pointLights[i]));
+        if (shadowsEnabled) {
+            for (int i = 0; i < ceilingShadow && i < (int)spotlightPositions.size(); ++i)
+                shadowAtlas.setView(i, spotlightPositions[i], spotlightDirection, 50.0f, 6.0f);
+            shadowAtlas.setView(ceilingShadow, ceilingLight.position, glm::vec3(0.0f, -1.0f, 0.0f), 140.0f, 15.0f);
+
+            auto drawCasters = [&](const glm::mat4& lightView, const glm::mat4& lightProjection, auto submit) {
+                submit();
+                depthShader.use();
+                depthShader.set(depthShader.camera.view, lightView);
+                depthShader.set(depthShader.camera.projection, lightProjection);
+                shadowQueue.flush(lightProjection * lightView, glm::vec3(glm::inverse(lightView)[3]), 15.0f);
+            };
+            //Zemin gölge düşürmez; duvarlar ve yüklü eserler statik, robot dinamiktir
+            auto drawStatic = [&](const glm::mat4& lightView, const glm::mat4& lightProjection) {
+                drawCasters(lightView, lightProjection, [&] {
+                    wallModel->submit(shadowQueue, depthShaders, TransformBuffer::IDENTITY, glm::vec3(1.0f), false);
+                    for (size_t i = 0; i < streamer.count(); ++i) {
+                        const ExhibitStreamer::Exhibit& exhibit = streamer.exhibit(i);
+                        if (exhibit.model)
+                            exhibit.model->submit(shadowQueue, depthShaders, exhibit.slot.index(), glm::vec3(1.0f), false);
+                    }
+                });
+            };
+            auto drawDynamic = [&](const glm::mat4& lightView, const glm::mat4& lightProjection) {
+                drawCasters(lightView, lightProjection, [&] { robot.submit(shadowQueue, depthShaders, armAngle); });
+            };
+            glm::vec3 robotCenter(0.0f);
+            float robotRadius = 0.0f;
+            if (robot.body && robot.arm)
+                robot.boundingSphere(robotCenter, robotRadius);
+            profiler.push("Shadows");
+            shadowAtlas.render(drawStatic, drawDynamic, robotCenter, robotRadius);
+            profiler.pop();
+        }
 
-            std::string intensityName = "pointIntensities[" + std::to_string(i) + "]";
-            glUniform1f(glGetUniformLocation(shader.ID, intensityName.c_str()), pointIntensities[i]);
+        glm::mat4 viewProjection = projection * view;
+        depthShader.use();
+        depthShader.set(depthShader.camera.view, view);
+        depthShader.set(depthShader.camera.projection, projection);
+        profiler.push("Occlusion Prepass");
+        //Yüklenen ya da bırakılan eserler örtücü kümesini değiştirir; eski derinlik piramidi atılır
+        if (streamer.residentVersion() != occluderVersion) {
+            occlusion.invalidate();
+            occluderVersion = streamer.residentVersion();
+        }
+        //Eleme kapalıyken örtücüler sahne hedefine çizilmesin diye kuyruk boşaltılır
+        if (occlusion.begin(viewProjection, w, h)) {
+            occluderQueue.flush(viewProjection, camera.Position, 100.0f);
+            occlusion.end();
         }
-        for (int i = 0; i < 2; ++i) {
-            std::string colorName = "pointColors[" + std::to_string(i) + "]";
-            glUniform3fv(glGetUniformLocation(shader.ID, colorName.c_str()), 1, glm::value_ptr(pointColors[i]));
+        else {
+            occluderQueue.clear();
         }
+        profiler.pop();
 
+        renderQueue.flush(viewProjection, camera.Position, 100.0f);
 
-        robot.draw(shader, armAngle);
+        if (crowdVisible > 0) {
+            profiler.push("Robot Crowd");
+            robot.body->DrawInstanced(sceneShaders, crowd);
+            profiler.pop();
+        }
 
+        if (showBounds) {
+            for (size_t i = 0; i < streamer.count(); ++i) {
+                const ExhibitStreamer::Exhibit& exhibit = streamer.exhibit(i);
+                debugDraw.box(exhibit.transform, exhibit.boundsMin, exhibit.boundsMax,
+                    exhibit.model ? glm::vec3(0.2f, 0.9f, 0.2f) : glm::vec3(0.9f, 0.6f, 0.1f));
+            }
+            if (robot.body && robot.arm) {
+                glm::vec3 robotCenter;
+                float robotRadius;
+                robot.boundingSphere(robotCenter, robotRadius);
+                debugDraw.sphere(robotCenter, robotRadius, glm::vec3(1.0f, 1.0f, 0.2f));
+            }
+        }
+        //Tarama ışını ve sınır çizgileri tek çağrıda çizilir; süreleri birlikte ölçülür
+        profiler.push("Debug Lines");
+        debugDraw.flush(viewProjection);
+        profiler.pop();
+
+        //Arayüz büyütülmüş görüntünün üstüne tam çözünürlükte çizilir
+        profiler.push("Upscale");
+        dynamicResolution.end();
+        profiler.pop();
 
         ImGui::Render();
+        profiler.push("ImGui");
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        profiler.pop();
+        profiler.endFrame();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (!firstFrameLogged || (!fullyLoadedLogged && assetLoader.idle())) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startupBegin;
+            if (!firstFrameLogged) {
+                std::cout << "First frame after " << elapsed.count() << " ms (" << ProgramCache::hits
+                    << " programs from cache, " << ProgramCache::misses << " compiled)\n";
+                firstFrameLogged = true;
+            }
+            if (!fullyLoadedLogged && assetLoader.idle()) {
+                std::cout << "All assets loaded after " << elapsed.count() << " ms ("
+                    << assetLoader.workerCount() << " worker threads)\n";
+                fullyLoadedLogged = true;
+            }
+        }
     }
+        // GL kaynakları bağlam kapanmadan serbest bırakılır.
+        streamer.clear();
+        floorModel.reset();
+        wallModel.reset();
+        robot.body.reset();
+        robot.arm.reset();
+        lightBuffer.release();
+        renderQueue.release();
+        occluderQueue.release();
+        occlusion.release();
+        shadowQueue.release();
+        shadowAtlas.release();
+        sceneTarget = nullptr;
+        dynamicResolution.release();
+        debugDraw.release();
+        profiler.release();
+
         ImGui_ImplOpenGL3_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
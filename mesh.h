@@ -3,11 +3,15 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <iostream>
 
-#include "shaderClass.h"
+#include "texture_manager.h"
 
 struct Vertex {
     glm::vec3 Position;
@@ -15,67 +19,489 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
-struct Texture {
-    unsigned int id;
-    std::string type;
-    std::string path;
+// GPU-side vertex for VertexFormat::Packed, 16 bytes instead of 32. The
+// position is unsigned-normalized within the mesh AABB and rebuilt in the
+// vertex shader from the instance's posOffset/posScale; the normal is a signed 10:10:10:2
+// word and the UV two half floats.
+struct PackedVertex {
+    uint16_t position[4];
+    uint32_t normal;
+    uint32_t texCoords;
 };
 
-class Mesh {
-public:
+enum class VertexFormat {
+    Float,
+    Packed
+};
+
+struct VertexAttribute {
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+// How a vertex buffer is laid out; MeshArena binds whatever it describes.
+struct VertexLayout {
+    GLsizei stride;
+    std::vector<VertexAttribute> attributes;
+
+    void apply() const {
+        for (const VertexAttribute& attribute : attributes) {
+            glEnableVertexAttribArray(attribute.location);
+            glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized,
+                stride, (void*)attribute.offset);
+        }
+    }
+
+    static const VertexLayout& get(VertexFormat format) {
+        static const VertexLayout floatLayout = { sizeof(Vertex), {
+            { 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position) },
+            { 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal) },
+            { 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords) } } };
+        static const VertexLayout packedLayout = { sizeof(PackedVertex), {
+            { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, position) },
+            { 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, normal) },
+            { 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, texCoords) } } };
+        return format == VertexFormat::Packed ? packedLayout : floatLayout;
+    }
+};
+
+// One level of detail: a range of the mesh's index buffer and the largest
+// geometric error it introduces, in object-space units.
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;
+};
+
+// CPU-side result of loading one OBJ shape, before any GL objects exist.
+// indices holds every LOD back to back; lods[0] is the full mesh.
+struct MeshData {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    std::vector<MeshLod> lods;
+    std::string diffuseTexture;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
 
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
+// Packs the position into the mesh AABB (see PackedVertex).
+inline PackedVertex packVertex(const Vertex& v, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 extent = boundsMax - boundsMin;
+    PackedVertex p;
+    for (int k = 0; k < 3; k++) {
+        float t = extent[k] > 0.0f ? (v.Position[k] - boundsMin[k]) / extent[k] : 0.0f;
+        p.position[k] = static_cast<uint16_t>(std::lround(glm::clamp(t, 0.0f, 1.0f) * 65535.0f));
+    }
+    p.position[3] = 0;
+    float length = glm::length(v.Normal);
+    glm::vec3 normal = length > 0.0f ? v.Normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    p.normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+    p.texCoords = glm::packHalf2x16(v.TexCoords);
+    return p;
+}
+
+// One submesh of a Model: a vertex range and an index range in the model's
+// MeshArena, plus its textures and LODs. Holds no GL buffers of its own;
+// the arena owns the geometry and is freed with the Model. Move-only, so
+// the texture references follow the mesh instead of being duplicated.
+class Mesh {
+public:
+    std::vector<TextureHandle> textures;
+    std::vector<MeshLod> lods;
+    int currentLod = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // Sphere around the AABB center holding every vertex; tighter than the
+    // box's half diagonal for round shapes.
+    float boundsRadius = 0.0f;
+    GLint baseVertex = 0;
+    size_t firstIndex = 0;
+
+    // Layout used for models created from now on. Packed halves the vertex
+    // size; Float keeps the source precision.
+    static inline VertexFormat vertexFormat = VertexFormat::Packed;
+
+    static constexpr float LOD_HYSTERESIS = 0.7f;
+
+    Mesh(const MeshData& data, std::vector<TextureHandle> textures, GLint baseVertex, size_t firstIndex)
+        : textures(std::move(textures)), lods(data.lods), baseVertex(baseVertex), firstIndex(firstIndex)
+    {
+        if (lods.empty())
+            lods.push_back({ 0, static_cast<unsigned int>(data.indices.size()), 0.0f });
+        computeBounds(data.vertices, boundsMin, boundsMax);
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (const Vertex& vertex : data.vertices) {
+            glm::vec3 offset = vertex.Position - center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        boundsRadius = std::sqrt(radiusSquared);
+    }
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
+
+    static void computeBounds(const std::vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsMax)
+    {
+        for (size_t i = 0; i < vertices.size(); i++) {
+            boundsMin = (i == 0) ? vertices[i].Position : glm::min(boundsMin, vertices[i].Position);
+            boundsMax = (i == 0) ? vertices[i].Position : glm::max(boundsMax, vertices[i].Position);
+        }
+    }
+
+    // Picks the coarsest LOD whose error stays below maxPixelError on
+    // screen. A coarser level is only taken once its error drops under
+    // LOD_HYSTERESIS times the limit, so meshes near a threshold do not
+    // flicker between levels.
+    void selectLod(float pixelsPerUnit, float maxPixelError)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-        setupMesh();
+        int lod = std::min(currentLod, static_cast<int>(lods.size()) - 1);
+        while (lod > 0 && lods[lod].error * pixelsPerUnit > maxPixelError)
+            lod--;
+        while (lod + 1 < static_cast<int>(lods.size()) && lods[lod + 1].error * pixelsPerUnit < maxPixelError * LOD_HYSTERESIS)
+            lod++;
+        currentLod = lod;
     }
 
-    void Draw(Shader& shader)
+    // Textures the mesh holds; shared textures are counted in full by every
+    // holder. The geometry is counted by the arena.
+    size_t memoryBytes() const
     {
-        for (unsigned int i = 0; i < textures.size(); i++)
+        size_t bytes = 0;
+        for (const TextureHandle& texture : textures)
+            bytes += texture.bytes();
+        return bytes;
+    }
+
+    // Where packed positions map back to object space; the identity for
+    // float vertices. Goes into every instance of this mesh.
+    glm::vec3 positionOffset(VertexFormat format) const
+    {
+        return format == VertexFormat::Packed ? boundsMin : glm::vec3(0.0f);
+    }
+
+    glm::vec3 positionScale(VertexFormat format) const
+    {
+        return format == VertexFormat::Packed ? boundsMax - boundsMin : glm::vec3(1.0f);
+    }
+
+    // Draws instanceCount copies; expects the owning arena's VAO to be bound
+    // with instance attributes carrying this mesh's position remap, and a
+    // TEXTURED shader variant in use when useTexture is set.
+    void DrawInstanced(bool useTexture, GLenum indexType, GLsizei instanceCount)
+    {
+        for (unsigned int i = 0; useTexture && i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            glBindTexture(GL_TEXTURE_2D, textures[i].id());
         }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        const MeshLod& lod = lods[currentLod];
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(lod.indexCount), indexType,
+            (void*)((firstIndex + lod.indexOffset) * indexSize), instanceCount, baseVertex);
         glActiveTexture(GL_TEXTURE0);
     }
+};
+
+// Vertex and index storage shared by every mesh with the same vertex format
+// and index type: one VAO over one vertex buffer and one index buffer.
+// Ranges are handed out first-fit and a buffer doubles when nothing fits,
+// copying its contents on the GPU, so the VAO stays the same for the life
+// of the program and draws of different models can share one multi-draw.
+// When releases leave the top half of a buffer free it is halved the same
+// way, so evicted models give their memory back; a buffer left empty is
+// deleted. The VAO is left to the context to free at exit.
+class GeometryPool {
+public:
+    struct Range {
+        size_t first = 0;
+        size_t count = 0;
+    };
+
+    static GeometryPool& get(VertexFormat format, GLenum indexType)
+    {
+        static GeometryPool floatShort(VertexFormat::Float, GL_UNSIGNED_SHORT);
+        static GeometryPool floatInt(VertexFormat::Float, GL_UNSIGNED_INT);
+        static GeometryPool packedShort(VertexFormat::Packed, GL_UNSIGNED_SHORT);
+        static GeometryPool packedInt(VertexFormat::Packed, GL_UNSIGNED_INT);
+        if (format == VertexFormat::Packed)
+            return indexType == GL_UNSIGNED_SHORT ? packedShort : packedInt;
+        return indexType == GL_UNSIGNED_SHORT ? floatShort : floatInt;
+    }
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    Range allocateVertices(size_t count)
+    {
+        return allocate(vertices, count);
+    }
+
+    Range allocateIndices(size_t count)
+    {
+        return allocate(indices, count);
+    }
+
+    void release(const Range& vertexRange, const Range& indexRange)
+    {
+        release(vertices, vertexRange);
+        release(indices, indexRange);
+    }
+
+    // first and count are in vertices / indices, not bytes. Uploads go
+    // through the copy-write target so no VAO's index binding is touched.
+    void uploadVertices(size_t first, const void* data, size_t count)
+    {
+        upload(vertices, first, data, count);
+    }
+
+    void uploadIndices(size_t first, const void* data, size_t count)
+    {
+        upload(indices, first, data, count);
+    }
+
+    unsigned int vertexArray() const
+    {
+        return VAO;
+    }
+
+    GLenum indexType() const
+    {
+        return type;
+    }
+
+    size_t indexSize() const
+    {
+        return indices.elementSize;
+    }
+
+    // Bytes allocated on the GPU, used or not.
+    size_t capacityBytes() const
+    {
+        return vertices.capacity * vertices.elementSize + indices.capacity * indices.elementSize;
+    }
 
 private:
-    unsigned int VAO, VBO, EBO;
+    struct Buffer {
+        unsigned int id = 0;
+        size_t elementSize = 0;
+        size_t capacity = 0;
+        std::vector<Range> free;  // sorted by first, never adjacent
+    };
+
+    static constexpr size_t INITIAL_CAPACITY = size_t(1) << 16;
 
-    void setupMesh()
+    VertexFormat format;
+    GLenum type;
+    unsigned int VAO = 0;
+    Buffer vertices, indices;
+
+    GeometryPool(VertexFormat format, GLenum indexType) : format(format), type(indexType)
     {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        vertices.elementSize = VertexLayout::get(format).stride;
+        indices.elementSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    }
 
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    Range allocate(Buffer& buffer, size_t count)
+    {
+        Range range;
+        range.count = count;
+        if (count == 0)
+            return range;
+        for (;;) {
+            for (size_t i = 0; i < buffer.free.size(); i++) {
+                Range& hole = buffer.free[i];
+                if (hole.count < count)
+                    continue;
+                range.first = hole.first;
+                hole.first += count;
+                hole.count -= count;
+                if (hole.count == 0)
+                    buffer.free.erase(buffer.free.begin() + i);
+                return range;
+            }
+            grow(buffer, std::max(buffer.capacity * 2, std::max(buffer.capacity + count, INITIAL_CAPACITY)));
+        }
+    }
+
+    void release(Buffer& buffer, const Range& range)
+    {
+        if (range.count == 0)
+            return;
+        addFree(buffer, range);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        const Range& tail = buffer.free.back();
+        if (tail.first == 0 && tail.count == buffer.capacity) {
+            glDeleteBuffers(1, &buffer.id);
+            buffer.id = 0;
+            buffer.capacity = 0;
+            buffer.free.clear();
+            return;
+        }
+        size_t capacity = buffer.capacity;
+        while (capacity / 2 >= INITIAL_CAPACITY && capacity / 2 >= tail.first)
+            capacity /= 2;
+        if (tail.first + tail.count == buffer.capacity && capacity < buffer.capacity)
+            resize(buffer, capacity);
+    }
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    static void addFree(Buffer& buffer, const Range& range)
+    {
+        auto next = std::lower_bound(buffer.free.begin(), buffer.free.end(), range,
+            [](const Range& a, const Range& b) { return a.first < b.first; });
+        next = buffer.free.insert(next, range);
+        if (next + 1 != buffer.free.end() && next->first + next->count == (next + 1)->first) {
+            next->count += (next + 1)->count;
+            buffer.free.erase(next + 1);
+        }
+        if (next != buffer.free.begin() && (next - 1)->first + (next - 1)->count == next->first) {
+            (next - 1)->count += next->count;
+            buffer.free.erase(next);
+        }
+    }
 
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    void grow(Buffer& buffer, size_t capacity)
+    {
+        size_t old = buffer.capacity;
+        resize(buffer, capacity);
+        addFree(buffer, { old, capacity - old });
+    }
 
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    // Moves the buffer to new storage of the given capacity, keeping its
+    // first min(old, new) elements. The caller fixes up the free list.
+    void resize(Buffer& buffer, size_t capacity)
+    {
+        unsigned int id;
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * buffer.elementSize, nullptr, GL_STATIC_DRAW);
+        if (buffer.id != 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer.id);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                std::min(buffer.capacity, capacity) * buffer.elementSize);
+            glDeleteBuffers(1, &buffer.id);
+        }
+        if (capacity < buffer.capacity) {
+            Range& tail = buffer.free.back();
+            tail.count = capacity - tail.first;
+            if (tail.count == 0)
+                buffer.free.pop_back();
+        }
+        buffer.id = id;
+        buffer.capacity = capacity;
 
+        if (VAO == 0)
+            glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        if (vertices.id != 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, vertices.id);
+            VertexLayout::get(format).apply();
+        }
+        if (indices.id != 0)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.id);
         glBindVertexArray(0);
     }
+
+    static void upload(Buffer& buffer, size_t first, const void* data, size_t count)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, first * buffer.elementSize, count * buffer.elementSize, data);
+    }
+};
+
+// A model's share of a GeometryPool: one vertex range and one index range
+// holding every submesh back to back. Indices stay local to their submesh
+// and are offset by the base vertex at draw time, so 16-bit indices only
+// need each submesh, not the whole model, to fit in 65536 vertices.
+class MeshArena {
+public:
+    VertexFormat format = VertexFormat::Float;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    MeshArena() = default;
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+
+    ~MeshArena()
+    {
+        if (pool)
+            pool->release(vertexRange, indexRange);
+    }
+
+    // Uploads all meshes and returns where each one starts in the pool.
+    void upload(const std::vector<MeshData>& meshes, std::vector<GLint>& baseVertices, std::vector<size_t>& firstIndices)
+    {
+        format = Mesh::vertexFormat;
+        size_t vertexCount = 0, indexCount = 0, largestMesh = 0;
+        for (const MeshData& mesh : meshes) {
+            vertexCount += mesh.vertices.size();
+            indexCount += mesh.indices.size();
+            largestMesh = std::max(largestMesh, mesh.vertices.size());
+        }
+        indexType = largestMesh <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+        pool = &GeometryPool::get(format, indexType);
+        vertexRange = pool->allocateVertices(vertexCount);
+        indexRange = pool->allocateIndices(indexCount);
+
+        size_t vertex = vertexRange.first, index = indexRange.first;
+        for (const MeshData& mesh : meshes) {
+            baseVertices.push_back(static_cast<GLint>(vertex));
+            firstIndices.push_back(index);
+
+            const std::vector<Vertex>& vertices = mesh.vertices;
+            if (format == VertexFormat::Packed) {
+                glm::vec3 boundsMin, boundsMax;
+                Mesh::computeBounds(vertices, boundsMin, boundsMax);
+                std::vector<PackedVertex> packed(vertices.size());
+                for (size_t v = 0; v < vertices.size(); v++)
+                    packed[v] = packVertex(vertices[v], boundsMin, boundsMax);
+                pool->uploadVertices(vertex, packed.data(), packed.size());
+            }
+            else {
+                pool->uploadVertices(vertex, vertices.data(), vertices.size());
+            }
+
+            if (indexType == GL_UNSIGNED_SHORT) {
+                std::vector<uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+                pool->uploadIndices(index, shortIndices.data(), shortIndices.size());
+            }
+            else {
+                pool->uploadIndices(index, mesh.indices.data(), mesh.indices.size());
+            }
+
+            vertex += vertices.size();
+            index += mesh.indices.size();
+        }
+        bytes = vertexCount * VertexLayout::get(format).stride + indexCount * pool->indexSize();
+    }
+
+    unsigned int vertexArray() const
+    {
+        return pool ? pool->vertexArray() : 0;
+    }
+
+    void bind() const
+    {
+        glBindVertexArray(vertexArray());
+    }
+
+    size_t memoryBytes() const
+    {
+        return bytes;
+    }
+
+private:
+    GeometryPool* pool = nullptr;
+    GeometryPool::Range vertexRange, indexRange;
+    size_t bytes = 0;
 };
 
 #endif
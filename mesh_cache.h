@@ -0,0 +1,294 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "hash.h"
+#include "mapped_file.h"
+#include "mesh.h"
+
+// On-disk cache of parsed OBJ models. The first load of "model.obj" writes
+// "model.obj.meshcache" next to it; later loads map that blob and copy the
+// vertex/index arrays out without touching the OBJ text. Every source file
+// (the OBJ and its mtllibs) is recorded with size, mtime and content hash:
+// a size change invalidates the entry, a matching mtime accepts it, and a
+// changed mtime falls back to comparing the hash.
+class MeshCache {
+public:
+    static std::string cachePath(const std::string& objPath) {
+        return objPath + ".meshcache";
+    }
+
+    static bool load(const std::string& objPath, std::vector<MeshData>& meshes) {
+        MappedFile blob(cachePath(objPath));
+        if (!blob.isOpen())
+            return false;
+
+        Reader in{ blob.data(), blob.data() + blob.size() };
+        const Header* header = in.take<Header>();
+        if (!header || std::memcmp(header->magic, MAGIC, 4) != 0 || header->version != VERSION)
+            return false;
+
+        std::string directory = directoryOf(objPath);
+        for (uint32_t i = 0; i < header->sourceCount; i++) {
+            const SourceRecord* source = in.take<SourceRecord>();
+            std::string name;
+            if (!source || !in.takeString(source->nameLength, name))
+                return false;
+            if (!sourceMatches(directory + "/" + name, *source))
+                return false;
+        }
+
+        std::vector<MeshData> result(header->meshCount);
+        for (MeshData& mesh : result) {
+            const MeshRecord* record = in.take<MeshRecord>();
+            if (!record || !in.takeString(record->textureLength, mesh.diffuseTexture))
+                return false;
+
+            mesh.boundsMin = glm::vec3(record->boundsMin[0], record->boundsMin[1], record->boundsMin[2]);
+            mesh.boundsMax = glm::vec3(record->boundsMax[0], record->boundsMax[1], record->boundsMax[2]);
+
+            const Vertex* vertices = in.takeArray<Vertex>(record->vertexCount);
+            const unsigned int* indices = in.takeArray<unsigned int>(record->indexCount);
+            const MeshLod* lods = in.takeArray<MeshLod>(record->lodCount);
+            if (!vertices || !indices || !lods)
+                return false;
+            mesh.vertices.assign(vertices, vertices + record->vertexCount);
+            mesh.indices.assign(indices, indices + record->indexCount);
+            mesh.lods.assign(lods, lods + record->lodCount);
+        }
+
+        meshes = std::move(result);
+        return true;
+    }
+
+    // Reads only the bounds of a cached model, without checking that the
+    // entry is still current; good enough for a stand-in before the load.
+    static bool loadBounds(const std::string& objPath, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+        MappedFile blob(cachePath(objPath));
+        if (!blob.isOpen())
+            return false;
+
+        Reader in{ blob.data(), blob.data() + blob.size() };
+        const Header* header = in.take<Header>();
+        if (!header || std::memcmp(header->magic, MAGIC, 4) != 0 || header->version != VERSION || header->meshCount == 0)
+            return false;
+
+        for (uint32_t i = 0; i < header->sourceCount; i++) {
+            const SourceRecord* source = in.take<SourceRecord>();
+            if (!source || !in.takeArray<char>(padded(source->nameLength)))
+                return false;
+        }
+
+        for (uint32_t i = 0; i < header->meshCount; i++) {
+            const MeshRecord* record = in.take<MeshRecord>();
+            if (!record || !in.takeArray<char>(padded(record->textureLength)) ||
+                !in.takeArray<Vertex>(record->vertexCount) || !in.takeArray<unsigned int>(record->indexCount) ||
+                !in.takeArray<MeshLod>(record->lodCount))
+                return false;
+            glm::vec3 meshMin(record->boundsMin[0], record->boundsMin[1], record->boundsMin[2]);
+            glm::vec3 meshMax(record->boundsMax[0], record->boundsMax[1], record->boundsMax[2]);
+            boundsMin = (i == 0) ? meshMin : glm::min(boundsMin, meshMin);
+            boundsMax = (i == 0) ? meshMax : glm::max(boundsMax, meshMax);
+        }
+        return true;
+    }
+
+    static void store(const std::string& objPath, const std::vector<MeshData>& meshes) {
+        std::string directory = directoryOf(objPath);
+        std::vector<std::string> sources = { std::filesystem::path(objPath).filename().string() };
+        for (const std::string& lib : findMaterialLibraries(objPath))
+            sources.push_back(lib);
+
+        std::vector<char> out;
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, 4);
+        header.version = VERSION;
+        header.sourceCount = static_cast<uint32_t>(sources.size());
+        header.meshCount = static_cast<uint32_t>(meshes.size());
+        append(out, &header, sizeof(header));
+
+        for (const std::string& name : sources) {
+            SourceRecord source = {};
+            if (!stampSource(directory + "/" + name, source))
+                return;
+            source.nameLength = static_cast<uint32_t>(name.size());
+            append(out, &source, sizeof(source));
+            appendString(out, name);
+        }
+
+        for (const MeshData& mesh : meshes) {
+            MeshRecord record = {};
+            record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+            record.indexCount = static_cast<uint32_t>(mesh.indices.size());
+            record.textureLength = static_cast<uint32_t>(mesh.diffuseTexture.size());
+            record.lodCount = static_cast<uint32_t>(mesh.lods.size());
+            for (int k = 0; k < 3; k++) {
+                record.boundsMin[k] = mesh.boundsMin[k];
+                record.boundsMax[k] = mesh.boundsMax[k];
+            }
+            append(out, &record, sizeof(record));
+            appendString(out, mesh.diffuseTexture);
+            append(out, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            append(out, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            append(out, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+        }
+
+        // Write to a temporary file and rename it over the old entry so a
+        // concurrent reader never maps a half-written blob.
+        std::string target = cachePath(objPath);
+        std::string temp = target + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+                std::cerr << "WARN: could not write mesh cache " << temp << std::endl;
+                return;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp, target, ec);
+        if (ec) {
+            std::cerr << "WARN: could not write mesh cache " << target << ": " << ec.message() << std::endl;
+            std::filesystem::remove(temp, ec);
+        }
+    }
+
+private:
+    static constexpr char MAGIC[4] = { 'V', 'M', 'M', 'C' };
+    static constexpr uint32_t VERSION = 3;
+
+    // Header and SourceRecord are multiples of 8 bytes and strings are
+    // padded to 8, so the source records' 64-bit fields stay 8-byte aligned
+    // in the mapped blob. Mesh records and their arrays come after all
+    // sources and hold only 4-byte fields; index arrays of odd length leave
+    // them 4-byte aligned, which is all they need.
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t sourceCount;
+        uint32_t meshCount;
+    };
+
+    struct SourceRecord {
+        uint64_t size;
+        int64_t mtime;
+        uint64_t hash;
+        uint32_t nameLength;
+        uint32_t padding;
+    };
+    static_assert(sizeof(Header) % 8 == 0 && sizeof(SourceRecord) % 8 == 0, "source records must stay 8-byte aligned");
+
+    struct MeshRecord {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureLength;
+        uint32_t lodCount;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    struct Reader {
+        const char* cursor;
+        const char* end;
+
+        template <typename T>
+        const T* take() {
+            return takeArray<T>(1);
+        }
+
+        template <typename T>
+        const T* takeArray(size_t count) {
+            size_t bytes = count * sizeof(T);
+            if (static_cast<size_t>(end - cursor) < bytes)
+                return nullptr;
+            const T* value = reinterpret_cast<const T*>(cursor);
+            cursor += bytes;
+            return value;
+        }
+
+        bool takeString(uint32_t length, std::string& value) {
+            const char* chars = takeArray<char>(padded(length));
+            if (!chars)
+                return false;
+            value.assign(chars, length);
+            return true;
+        }
+    };
+
+    static size_t padded(size_t length) {
+        return (length + 7) & ~size_t(7);
+    }
+
+    static void append(std::vector<char>& out, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    static void appendString(std::vector<char>& out, const std::string& value) {
+        append(out, value.data(), value.size());
+        out.resize(out.size() + padded(value.size()) - value.size(), '\0');
+    }
+
+    static std::string directoryOf(const std::string& path) {
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? "." : path.substr(0, separator);
+    }
+
+    static bool stampSource(const std::string& path, SourceRecord& source) {
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec)
+            return false;
+
+        MappedFile file(path);
+        source.size = file.size();
+        source.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+        source.hash = hashBytes(file.data(), file.size());
+        return true;
+    }
+
+    static bool sourceMatches(const std::string& path, const SourceRecord& cached) {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        if (ec || size != cached.size)
+            return false;
+
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec)
+            return false;
+        if (static_cast<int64_t>(mtime.time_since_epoch().count()) == cached.mtime)
+            return true;
+
+        // Touched but possibly unchanged (e.g. a fresh checkout): decide by content.
+        MappedFile file(path);
+        return hashBytes(file.data(), file.size()) == cached.hash;
+    }
+
+    static std::vector<std::string> findMaterialLibraries(const std::string& objPath) {
+        std::vector<std::string> libraries;
+        MappedFile file(objPath);
+        const char* p = file.data();
+        const char* end = p + file.size();
+        while (p < end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!lineEnd) lineEnd = end;
+            if (lineEnd - p > 7 && std::memcmp(p, "mtllib ", 7) == 0) {
+                std::string name(p + 7, lineEnd);
+                while (!name.empty() && (name.back() == '\r' || name.back() == ' '))
+                    name.pop_back();
+                libraries.push_back(name);
+            }
+            p = lineEnd + 1;
+        }
+        return libraries;
+    }
+};
+
+#endif
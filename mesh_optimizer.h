@@ -0,0 +1,198 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.h"
+
+// Load-time cleanup of the one-vertex-per-corner meshes coming out of the
+// OBJ loader: identical vertices are welded, triangles are reordered for the
+// post-transform cache (Tipsify, Sander et al. 2007) and vertices are
+// renumbered in first-use order so vertex fetch walks memory linearly.
+class MeshOptimizer {
+public:
+    static const unsigned int CACHE_SIZE = 16;
+
+    struct Stats {
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;
+        float acmrBefore = 0.0f;
+        float acmrAfter = 0.0f;
+    };
+
+    static Stats optimize(MeshData& mesh) {
+        Stats stats;
+        stats.verticesBefore = mesh.vertices.size();
+        stats.acmrBefore = computeACMR(mesh.indices, mesh.vertices.size());
+
+        weldVertices(mesh.vertices, mesh.indices);
+        mesh.indices = optimizeVertexCache(mesh.indices, mesh.vertices.size());
+        optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+        stats.verticesAfter = mesh.vertices.size();
+        stats.acmrAfter = computeACMR(mesh.indices, mesh.vertices.size());
+        return stats;
+    }
+
+    // Average cache miss ratio: transformed vertices per triangle for a FIFO
+    // cache of the given size. 3.0 means no reuse at all, ~0.5 is ideal.
+    static float computeACMR(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE) {
+        if (indices.size() < 3)
+            return 0.0f;
+
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        unsigned int timestamp = cacheSize + 1;
+        size_t misses = 0;
+        for (unsigned int v : indices) {
+            if (timestamp - cacheTime[v] > cacheSize) {
+                cacheTime[v] = timestamp++;
+                misses++;
+            }
+        }
+        return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    }
+
+    static void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+        unique.reserve(vertices.size());
+
+        std::vector<Vertex> welded;
+        std::vector<unsigned int> remap(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            auto inserted = unique.emplace(vertices[i], static_cast<unsigned int>(welded.size()));
+            if (inserted.second)
+                welded.push_back(vertices[i]);
+            remap[i] = inserted.first->second;
+        }
+
+        for (unsigned int& index : indices)
+            index = remap[index];
+        vertices = std::move(welded);
+    }
+
+    static std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE) {
+        size_t triangleCount = indices.size() / 3;
+        std::vector<unsigned int> result;
+        result.reserve(triangleCount * 3);
+        if (triangleCount == 0)
+            return result;
+
+        // Vertex -> triangle adjacency in CSR form.
+        std::vector<unsigned int> liveCount(vertexCount, 0);
+        for (unsigned int v : indices)
+            liveCount[v]++;
+
+        std::vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + liveCount[v];
+
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> candidates;
+        unsigned int timestamp = cacheSize + 1;
+        size_t cursor = 0;
+
+        long fan = static_cast<long>(indices[0]);
+        while (fan >= 0) {
+            candidates.clear();
+            for (unsigned int a = offsets[fan]; a < offsets[fan + 1]; a++) {
+                unsigned int t = adjacency[a];
+                if (emitted[t])
+                    continue;
+
+                for (int k = 0; k < 3; k++) {
+                    unsigned int v = indices[t * 3 + k];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    liveCount[v]--;
+                    if (timestamp - cacheTime[v] > cacheSize)
+                        cacheTime[v] = timestamp++;
+                }
+                emitted[t] = true;
+            }
+
+            // Prefer a candidate that will still be in cache after its
+            // remaining triangles are emitted, oldest first. Candidates that
+            // would fall out of cache have priority 0 and are never taken;
+            // without any other, the next fan comes from the dead-end stack.
+            long next = -1;
+            unsigned int best = 0;
+            for (unsigned int v : candidates) {
+                if (liveCount[v] == 0)
+                    continue;
+                unsigned int priority = 0;
+                if (timestamp - cacheTime[v] + 2 * liveCount[v] <= cacheSize)
+                    priority = timestamp - cacheTime[v];
+                if (priority > best) {
+                    best = priority;
+                    next = v;
+                }
+            }
+
+            if (next < 0) {
+                while (!deadEnd.empty() && next < 0) {
+                    unsigned int v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (liveCount[v] > 0)
+                        next = v;
+                }
+                while (next < 0 && cursor < vertexCount) {
+                    if (liveCount[cursor] > 0)
+                        next = static_cast<long>(cursor);
+                    cursor++;
+                }
+            }
+            fan = next;
+        }
+        return result;
+    }
+
+    static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+
+        for (unsigned int& index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = static_cast<unsigned int>(ordered.size());
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices = std::move(ordered);
+    }
+
+private:
+    struct VertexHash {
+        size_t operator()(const Vertex& v) const {
+            uint32_t words[sizeof(Vertex) / 4];
+            std::memcpy(words, &v, sizeof(Vertex));
+            uint64_t hash = 14695981039346656037ull;
+            for (uint32_t w : words) {
+                hash ^= w;
+                hash *= 1099511628211ull;
+            }
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    struct VertexEqual {
+        bool operator()(const Vertex& a, const Vertex& b) const {
+            return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+};
+
+#endif
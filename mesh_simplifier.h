@@ -0,0 +1,439 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "hash.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+
+// Builds the LOD chain of a mesh with quadric error metrics (Garland &
+// Heckbert 1997). Collapses are half-edge collapses onto an existing vertex,
+// so every LOD is just another index range over the same vertex buffer.
+// Vertices sharing a position move together and each is remapped to the
+// matching copy at the target, so UV seams stay put while hard-edged normals
+// may be merged. Non-simple border vertices are locked, border vertices only
+// slide along their border, and collapses that fold a triangle are rejected.
+class MeshSimplifier {
+public:
+    static const int MAX_LODS = 4;
+    // Largest allowed error, relative to the mesh extent.
+    static constexpr float MAX_ERROR = 0.02f;
+
+    // Appends up to MAX_LODS - 1 simplified index ranges to mesh.indices,
+    // each aiming at half the triangles of the previous one, and fills
+    // mesh.lods. Stops early once a level stops paying for itself.
+    static void buildLods(MeshData& mesh) {
+        mesh.lods.assign(1, { 0, static_cast<unsigned int>(mesh.indices.size()), 0.0f });
+
+        glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+        float scale = std::max(extent.x, std::max(extent.y, extent.z));
+        std::vector<unsigned int> source(mesh.indices);
+        size_t previous = source.size();
+
+        for (int level = 1; level < MAX_LODS; level++) {
+            size_t target = (previous / 2) / 3 * 3;
+            float error = 0.0f;
+            std::vector<unsigned int> lod = simplify(mesh.vertices, source, target, MAX_ERROR, &error);
+            if (lod.empty() || lod.size() > previous * 85 / 100)
+                break;
+
+            lod = MeshOptimizer::optimizeVertexCache(lod, mesh.vertices.size());
+            mesh.lods.push_back({ static_cast<unsigned int>(mesh.indices.size()),
+                static_cast<unsigned int>(lod.size()), error * scale });
+            mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+            previous = lod.size();
+        }
+    }
+
+    // Collapses edges of the cheapest error first until at most
+    // targetIndexCount indices remain or the next collapse would exceed
+    // targetError (relative to the mesh extent). resultError receives the
+    // largest error actually introduced.
+    static std::vector<unsigned int> simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& sourceIndices,
+        size_t targetIndexCount, float targetError, float* resultError = nullptr) {
+        std::vector<unsigned int> indices(sourceIndices);
+        size_t vertexCount = vertices.size();
+        if (resultError)
+            *resultError = 0.0f;
+        if (indices.size() <= targetIndexCount || vertexCount == 0)
+            return indices;
+
+        // Work in the unit cube so errors are relative to the mesh size.
+        glm::vec3 boundsMin = vertices[0].Position, boundsMax = vertices[0].Position;
+        for (const Vertex& v : vertices) {
+            boundsMin = glm::min(boundsMin, v.Position);
+            boundsMax = glm::max(boundsMax, v.Position);
+        }
+        glm::vec3 extent = boundsMax - boundsMin;
+        float scale = std::max(extent.x, std::max(extent.y, extent.z));
+        float invScale = scale > 0.0f ? 1.0f / scale : 0.0f;
+        std::vector<glm::dvec3> positions(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+            positions[i] = glm::dvec3((vertices[i].Position - boundsMin) * invScale);
+
+        // Positions are the unit of simplification; the vertices sharing a
+        // position ("wedges", split by UV or normal seams) move together.
+        std::vector<unsigned int> remap = buildPositionRemap(vertices);
+        std::vector<unsigned int> wedgeNext(vertexCount);
+        for (unsigned int i = 0; i < vertexCount; i++) {
+            unsigned int p = remap[i];
+            wedgeNext[i] = (p == i) ? i : wedgeNext[p];
+            if (p != i)
+                wedgeNext[p] = i;
+        }
+        std::vector<unsigned int> borderNext(vertexCount, ~0u), borderPrev(vertexCount, ~0u);
+        std::vector<unsigned char> kind = classifyPositions(remap, indices, borderNext, borderPrev);
+
+        std::vector<Quadric> quadrics(vertexCount);
+        fillQuadrics(positions, remap, indices, borderNext, quadrics);
+
+        std::vector<unsigned int> collapse(vertexCount);
+        std::vector<unsigned char> touched(vertexCount);
+        std::vector<unsigned int> adjacencyOffsets, adjacency;
+        double errorLimit = static_cast<double>(targetError) * targetError;
+        double maxError = 0.0;
+
+        while (indices.size() > targetIndexCount) {
+            buildAdjacency(indices, vertexCount, adjacencyOffsets, adjacency);
+
+            std::vector<Collapse> candidates;
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                for (int e = 0; e < 3; e++) {
+                    unsigned int a = remap[indices[t + e]], b = remap[indices[t + (e + 1) % 3]];
+                    if (canCollapse(a, b, kind, borderNext, borderPrev))
+                        candidates.push_back({ a, b, collapseCost(quadrics, a, positions[b]) });
+                    if (canCollapse(b, a, kind, borderNext, borderPrev))
+                        candidates.push_back({ b, a, collapseCost(quadrics, b, positions[a]) });
+                }
+            }
+            if (candidates.empty())
+                break;
+            std::sort(candidates.begin(), candidates.end(),
+                [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+            // Each collapse removes about two triangles; only the cheapest
+            // third of the candidates is considered per pass so the greedy
+            // order stays close to a global one.
+            size_t budget = (indices.size() - targetIndexCount) / 6 + 1;
+            size_t considered = std::max<size_t>(candidates.size() / 3, 1);
+            size_t collapsed = 0;
+            for (unsigned int i = 0; i < vertexCount; i++)
+                collapse[i] = i;
+            std::fill(touched.begin(), touched.end(), 0);
+
+            for (size_t c = 0; c < considered && collapsed < budget; c++) {
+                const Collapse& candidate = candidates[c];
+                if (candidate.cost > errorLimit)
+                    break;
+                if (touched[candidate.from] || touched[candidate.to])
+                    continue;
+                if (!mapWedges(candidate.from, candidate.to, vertices, remap, wedgeNext, indices, adjacencyOffsets, adjacency, collapse))
+                    continue;
+                if (flipsTriangle(candidate.from, candidate.to, positions, remap, wedgeNext, indices, adjacencyOffsets, adjacency)) {
+                    unsigned int w = candidate.from;
+                    do {
+                        collapse[w] = w;
+                        w = wedgeNext[w];
+                    } while (w != candidate.from);
+                    continue;
+                }
+
+                quadrics[candidate.to].add(quadrics[candidate.from]);
+                maxError = std::max(maxError, candidate.cost);
+                collapsed++;
+
+                // Lock the one-ring so later flip checks in this pass see
+                // final positions.
+                unsigned int w = candidate.from;
+                do {
+                    for (unsigned int k = adjacencyOffsets[w]; k < adjacencyOffsets[w + 1]; k++) {
+                        unsigned int t = adjacency[k];
+                        for (int e = 0; e < 3; e++)
+                            touched[remap[indices[t + e]]] = 1;
+                    }
+                    w = wedgeNext[w];
+                } while (w != candidate.from);
+            }
+            if (collapsed == 0)
+                break;
+
+            size_t write = 0;
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                unsigned int a = collapse[indices[t]], b = collapse[indices[t + 1]], c = collapse[indices[t + 2]];
+                if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+                    continue;
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+            indices.resize(write);
+        }
+
+        if (resultError)
+            *resultError = static_cast<float>(std::sqrt(maxError));
+        return indices;
+    }
+
+private:
+    enum Kind : unsigned char {
+        MANIFOLD,
+        BORDER,
+        LOCKED
+    };
+
+    static constexpr double BORDER_WEIGHT = 10.0;
+
+    // Symmetric 4x4 plane quadric plus the area it was accumulated from.
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0, c = 0;
+        double weight = 0;
+
+        void addPlane(const glm::dvec3& n, double d, double w) {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+            b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric& q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02;
+            a11 += q.a11; a12 += q.a12; a22 += q.a22;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+        }
+
+        double evaluate(const glm::dvec3& p) const {
+            double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return std::fabs(r);
+        }
+    };
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const {
+            return static_cast<size_t>(hashBytes(&p, sizeof(p)));
+        }
+    };
+
+    // Maps every vertex to the first vertex sharing its position, so seams
+    // (same position, different normal or UV) are recognised.
+    static std::vector<unsigned int> buildPositionRemap(const std::vector<Vertex>& vertices) {
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> first;
+        first.reserve(vertices.size());
+        std::vector<unsigned int> remap(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            remap[i] = first.emplace(vertices[i].Position, i).first->second;
+        return remap;
+    }
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b) {
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    // Sorts every position into manifold, simple border (exactly one
+    // outgoing and one incoming open edge) or locked, and records the
+    // border neighbours.
+    static std::vector<unsigned char> classifyPositions(const std::vector<unsigned int>& remap, const std::vector<unsigned int>& indices,
+        std::vector<unsigned int>& borderNext, std::vector<unsigned int>& borderPrev) {
+        size_t vertexCount = remap.size();
+        std::unordered_set<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            for (int e = 0; e < 3; e++)
+                edges.insert(edgeKey(remap[indices[t + e]], remap[indices[t + (e + 1) % 3]]));
+        }
+
+        std::vector<unsigned char> outgoing(vertexCount), incoming(vertexCount);
+        for (uint64_t key : edges) {
+            unsigned int a = static_cast<unsigned int>(key >> 32), b = static_cast<unsigned int>(key);
+            if (edges.count(edgeKey(b, a)) == 0) {
+                outgoing[a] = static_cast<unsigned char>(std::min(outgoing[a] + 1, 2));
+                incoming[b] = static_cast<unsigned char>(std::min(incoming[b] + 1, 2));
+                borderNext[a] = b;
+                borderPrev[b] = a;
+            }
+        }
+
+        std::vector<unsigned char> kind(vertexCount, MANIFOLD);
+        for (unsigned int i = 0; i < vertexCount; i++) {
+            if (outgoing[i] == 0 && incoming[i] == 0)
+                continue;
+            kind[i] = (outgoing[i] == 1 && incoming[i] == 1) ? BORDER : LOCKED;
+        }
+        return kind;
+    }
+
+    static void fillQuadrics(const std::vector<glm::dvec3>& positions, const std::vector<unsigned int>& remap,
+        const std::vector<unsigned int>& indices, const std::vector<unsigned int>& borderNext, std::vector<Quadric>& quadrics) {
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            unsigned int v[3] = { indices[t], indices[t + 1], indices[t + 2] };
+            glm::dvec3 normal = glm::cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+            double length = glm::length(normal);
+            if (length <= 0.0)
+                continue;
+            normal /= length;
+            double area = 0.5 * length;
+            double d = -glm::dot(normal, positions[v[0]]);
+
+            for (int e = 0; e < 3; e++) {
+                quadrics[remap[v[e]]].addPlane(normal, d, area);
+
+                // Border edges get a heavily weighted plane perpendicular to
+                // the triangle, which keeps open outlines in place.
+                unsigned int a = remap[v[e]], b = remap[v[(e + 1) % 3]];
+                if (borderNext[a] != b)
+                    continue;
+                glm::dvec3 edge = positions[b] - positions[a];
+                double edgeLength = glm::length(edge);
+                if (edgeLength <= 0.0)
+                    continue;
+                glm::dvec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+                double edgeD = -glm::dot(edgeNormal, positions[a]);
+                double weight = edgeLength * edgeLength * BORDER_WEIGHT;
+                quadrics[a].addPlane(edgeNormal, edgeD, weight);
+                quadrics[b].addPlane(edgeNormal, edgeD, weight);
+            }
+        }
+    }
+
+    static void buildAdjacency(const std::vector<unsigned int>& indices, size_t vertexCount,
+        std::vector<unsigned int>& offsets, std::vector<unsigned int>& adjacency) {
+        offsets.assign(vertexCount + 1, 0);
+        for (unsigned int index : indices)
+            offsets[index + 1]++;
+        for (size_t i = 0; i < vertexCount; i++)
+            offsets[i + 1] += offsets[i];
+
+        adjacency.resize(indices.size());
+        std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            for (int e = 0; e < 3; e++)
+                adjacency[cursor[indices[t + e]]++] = static_cast<unsigned int>(t);
+        }
+    }
+
+    static bool canCollapse(unsigned int from, unsigned int to, const std::vector<unsigned char>& kind,
+        const std::vector<unsigned int>& borderNext, const std::vector<unsigned int>& borderPrev) {
+        if (kind[from] == MANIFOLD)
+            return true;
+        if (kind[from] == BORDER)
+            return borderNext[from] == to || borderPrev[from] == to;
+        return false;
+    }
+
+    // Picks, for every wedge of position "from", the wedge of "to" it turns
+    // into. A wedge sharing a triangle with "to" takes the wedge across that
+    // edge. Any other wedge follows a sibling with the same UV (same island)
+    // to that island's UV at "to", and takes the copy there with the closest
+    // normal. Fails when an island never reaches "to", which is what keeps
+    // UV seams in place.
+    static bool mapWedges(unsigned int from, unsigned int to, const std::vector<Vertex>& vertices,
+        const std::vector<unsigned int>& remap, const std::vector<unsigned int>& wedgeNext, const std::vector<unsigned int>& indices,
+        const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& adjacency, std::vector<unsigned int>& collapse) {
+        unsigned int w = from;
+        do {
+            for (unsigned int k = offsets[w]; k < offsets[w + 1] && collapse[w] == w; k++) {
+                unsigned int t = adjacency[k];
+                for (int e = 0; e < 3; e++) {
+                    if (remap[indices[t + e]] == to)
+                        collapse[w] = indices[t + e];
+                }
+            }
+            w = wedgeNext[w];
+        } while (w != from);
+
+        bool mapped = true;
+        w = from;
+        do {
+            if (collapse[w] == w) {
+                unsigned int island = ~0u;
+                unsigned int sibling = from;
+                do {
+                    if (collapse[sibling] != sibling && vertices[sibling].TexCoords == vertices[w].TexCoords)
+                        island = collapse[sibling];
+                    sibling = wedgeNext[sibling];
+                } while (sibling != from && island == ~0u);
+
+                unsigned int target = ~0u;
+                if (island != ~0u) {
+                    const glm::vec2& uv = vertices[island].TexCoords;
+                    float bestDot = -2.0f;
+                    unsigned int candidate = to;
+                    do {
+                        float d = glm::dot(vertices[candidate].Normal, vertices[w].Normal);
+                        if (vertices[candidate].TexCoords == uv && d > bestDot) {
+                            bestDot = d;
+                            target = candidate;
+                        }
+                        candidate = wedgeNext[candidate];
+                    } while (candidate != to);
+                }
+                if (target == ~0u) {
+                    mapped = false;
+                    break;
+                }
+                collapse[w] = target;
+            }
+            w = wedgeNext[w];
+        } while (w != from);
+
+        if (!mapped) {
+            w = from;
+            do {
+                collapse[w] = w;
+                w = wedgeNext[w];
+            } while (w != from);
+        }
+        return mapped;
+    }
+
+    static double collapseCost(const std::vector<Quadric>& quadrics, unsigned int from, const glm::dvec3& target) {
+        const Quadric& q = quadrics[from];
+        return q.weight > 0.0 ? q.evaluate(target) / q.weight : 0.0;
+    }
+
+    static bool flipsTriangle(unsigned int from, unsigned int to, const std::vector<glm::dvec3>& positions,
+        const std::vector<unsigned int>& remap, const std::vector<unsigned int>& wedgeNext, const std::vector<unsigned int>& indices,
+        const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& adjacency) {
+        unsigned int w = from;
+        do {
+            for (unsigned int k = offsets[w]; k < offsets[w + 1]; k++) {
+                unsigned int t = adjacency[k];
+                unsigned int v[3] = { remap[indices[t]], remap[indices[t + 1]], remap[indices[t + 2]] };
+                if (v[0] == to || v[1] == to || v[2] == to)
+                    continue;
+
+                glm::dvec3 before = glm::cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+                for (int e = 0; e < 3; e++)
+                    v[e] = v[e] == from ? to : v[e];
+                glm::dvec3 after = glm::cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+
+                // Reject anything turning by more than ~75 degrees, and slivers.
+                double lengths = glm::length(before) * glm::length(after);
+                if (lengths <= 0.0 || glm::dot(before, after) < 0.25 * lengths)
+                    return true;
+            }
+            w = wedgeNext[w];
+        } while (w != from);
+        return false;
+    }
+};
+
+#endif
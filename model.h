@@ -4,45 +4,212 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 #include "mesh.h"
-#include "stb_image.h"
+#include "texture_manager.h"
+#include <memory>
+#include <sstream>
 #include <unordered_map>
 #include "stb_image_loader.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_parser.h"
+#include "render_queue.h"
+#include "instance_buffer.h"
+#include "shader_variants.h"
+
+// Everything Model needs from disk, produced without a GL context so it can
+// be built on a worker thread.
+struct ModelData {
+    std::string directory;
+    std::vector<MeshData> meshes;
+    std::vector<ImageData> images;
+};
 
 class Model {
 public:
     std::vector<Mesh> meshes;
+    MeshArena arena;
     std::string directory;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // Sphere around the AABB center enclosing every mesh's sphere.
+    float boundsRadius = 0.0f;
 
     Model(const std::string& path) {
-        loadModel(path);
+        upload(load(path));
+    }
+
+    explicit Model(ModelData&& data) {
+        upload(std::move(data));
+    }
+
+    // Chooses every mesh's LOD for one placement of the model, from how many
+    // pixels an object-space unit covers at the model's distance.
+    void selectLod(const glm::mat4& modelMat, const glm::vec3& cameraPos, const glm::mat4& projection,
+        float viewportHeight, float maxPixelError = 1.0f) {
+        glm::vec3 center = glm::vec3(modelMat * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(modelMat[0])),
+            std::max(glm::length(glm::vec3(modelMat[1])), glm::length(glm::vec3(modelMat[2]))));
+        float radius = boundsRadius * scale;
+        float distance = std::max(glm::length(center - cameraPos) - radius, 0.1f);
+
+        // projection[1][1] is cot(fovY / 2).
+        float pixelsPerUnit = viewportHeight * 0.5f * projection[1][1] / distance * scale;
+        for (auto& mesh : meshes)
+            mesh.selectLod(pixelsPerUnit, maxPixelError);
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = arena.memoryBytes();
+        for (const auto& mesh : meshes)
+            bytes += mesh.memoryBytes();
+        return bytes;
+    }
+
+    size_t drawnTriangles() const {
+        size_t triangles = 0;
+        for (const auto& mesh : meshes)
+            triangles += mesh.lods[mesh.currentLod].indexCount / 3;
+        return triangles;
+    }
+
+    // Queues one item per mesh at its current LOD, placed by the given
+    // TransformBuffer slot, with the TEXTURED variant for textured meshes.
+    // A mesh without a texture is drawn in color even when useTexture is set.
+    void submit(RenderQueue& queue, ShaderVariants& shaders, uint32_t transform,
+        const glm::vec3& color = glm::vec3(1.0f), bool useTexture = true) const {
+        for (const auto& mesh : meshes) {
+            const MeshLod& lod = mesh.lods[mesh.currentLod];
+            DrawItem item;
+            item.vao = arena.vertexArray();
+            item.indexType = arena.indexType;
+            item.count = static_cast<GLsizei>(lod.indexCount);
+            item.first = mesh.firstIndex + lod.indexOffset;
+            item.baseVertex = mesh.baseVertex;
+            item.texture = mesh.textures.empty() ? 0 : mesh.textures[0].id();
+            item.useTexture = useTexture && item.texture != 0;
+            item.shader = &shaders.get(item.useTexture ? SHADER_TEXTURED : SHADER_NONE);
+            item.color = color;
+            item.posOffset = mesh.positionOffset(arena.format);
+            item.posScale = mesh.positionScale(arena.format);
+            item.transform = transform;
+            item.hasBounds = true;
+            item.boundsMin = mesh.boundsMin;
+            item.boundsMax = mesh.boundsMax;
+            item.boundsRadius = mesh.boundsRadius;
+            queue.submit(item);
+        }
     }
 
-    void Draw(Shader& shader) {
+    // Draws every instance in one instanced call per mesh, at the meshes'
+    // current LOD, each with the variant it needs. Each mesh gets its own
+    // copy of the instances carrying its position remap.
+    void DrawInstanced(ShaderVariants& shaders, const std::vector<InstanceData>& instances, bool useTexture = true) {
+        if (instances.empty())
+            return;
+        InstanceBuffer& buffer = InstanceBuffer::instance();
+        std::vector<InstanceData> meshInstances(instances);
+        arena.bind();
         for (auto& mesh : meshes) {
-            mesh.Draw(shader);
+            glm::vec3 posOffset = mesh.positionOffset(arena.format);
+            glm::vec3 posScale = mesh.positionScale(arena.format);
+            for (InstanceData& instance : meshInstances) {
+                instance.posOffset = posOffset;
+                instance.posScale = posScale;
+            }
+            buffer.upload(meshInstances.data(), meshInstances.size());
+            buffer.bindAttributes(0);
+            bool textured = useTexture && !mesh.textures.empty();
+            shaders.get(textured ? SHADER_TEXTURED : SHADER_NONE).use();
+            mesh.DrawInstanced(textured, arena.indexType, static_cast<GLsizei>(instances.size()));
         }
+        glBindVertexArray(0);
+    }
+
+    // Parses the OBJ (or its mesh cache) and lists the textures it needs,
+    // leaving the images undecoded. Safe to call from any thread.
+    static ModelData loadGeometry(const std::string& path) {
+        ModelData data;
+        data.directory = path.substr(0, path.find_last_of("/\\"));
+
+        if (!MeshCache::load(path, data.meshes)) {
+            parseObj(path, data.directory, data.meshes);
+            MeshCache::store(path, data.meshes);
+        }
+
+        for (const auto& mesh : data.meshes) {
+            if (mesh.diffuseTexture.empty())
+                continue;
+            std::string full_path = data.directory + "/" + mesh.diffuseTexture;
+            bool listed = false;
+            for (const auto& image : data.images)
+                listed = listed || image.path == full_path;
+            if (!listed) {
+                data.images.emplace_back();
+                data.images.back().path = full_path;
+            }
+        }
+        return data;
+    }
+
+    static ModelData load(const std::string& path) {
+        ModelData data = loadGeometry(path);
+        for (auto& image : data.images)
+            TextureManager::decodeImage(image);
+        return data;
     }
 
 private:
-    void loadModel(const std::string& path) {
+    void upload(ModelData&& data) {
+        directory = data.directory;
+
+        std::unordered_map<std::string, TextureHandle> loaded_textures;
+        for (auto& image : data.images) {
+            loaded_textures[image.path] = TextureManager::instance().acquire(image);
+        }
+
+        std::vector<GLint> baseVertices;
+        std::vector<size_t> firstIndices;
+        arena.upload(data.meshes, baseVertices, firstIndices);
+
+        for (size_t i = 0; i < data.meshes.size(); i++) {
+            const MeshData& mesh = data.meshes[i];
+            boundsMin = (i == 0) ? mesh.boundsMin : glm::min(boundsMin, mesh.boundsMin);
+            boundsMax = (i == 0) ? mesh.boundsMax : glm::max(boundsMax, mesh.boundsMax);
+
+            std::vector<TextureHandle> mesh_textures;
+            if (!mesh.diffuseTexture.empty()) {
+                mesh_textures.push_back(loaded_textures[directory + "/" + mesh.diffuseTexture]);
+            }
+
+            meshes.emplace_back(mesh, std::move(mesh_textures), baseVertices[i], firstIndices[i]);
+        }
+
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        for (const auto& mesh : meshes) {
+            glm::vec3 meshCenter = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+            boundsRadius = std::max(boundsRadius, glm::length(meshCenter - center) + mesh.boundsRadius);
+        }
+        boundsRadius = std::min(boundsRadius, glm::length(boundsMax - boundsMin) * 0.5f);
+    }
+
+    static void parseObj(const std::string& path, const std::string& directory, std::vector<MeshData>& meshData) {
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
         std::string warn, err;
 
-        directory = path.substr(0, path.find_last_of("/\\"));
-
-        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str(), directory.c_str());
+        bool ret = ObjParser::load(&attrib, &shapes, &materials, &warn, &err, path.c_str(), directory.c_str());
 
         if (!warn.empty()) std::cout << "WARN: " << warn << std::endl;
         if (!err.empty()) std::cerr << "ERR: " << err << std::endl;
         if (!ret) throw std::runtime_error("Failed to load model: " + path);
 
-        std::unordered_map<std::string, Texture> loaded_textures;
-
+        std::ostringstream report;
         for (const auto& shape : shapes) {
-            std::vector<Vertex> vertices;
-            std::vector<unsigned int> indices;
+            MeshData data;
+            std::vector<Vertex>& vertices = data.vertices;
+            std::vector<unsigned int>& indices = data.indices;
 
             for (const auto& index : shape.mesh.indices) {
                 Vertex vertex = {};
@@ -66,57 +233,36 @@ private:
                     vertex.TexCoords = glm::vec2(0.0f);
                 }
 
+                if (vertices.empty()) {
+                    data.boundsMin = data.boundsMax = vertex.Position;
+                }
+                else {
+                    data.boundsMin = glm::min(data.boundsMin, vertex.Position);
+                    data.boundsMax = glm::max(data.boundsMax, vertex.Position);
+                }
+
                 vertices.push_back(vertex);
                 indices.push_back(indices.size());
             }
 
-            std::vector<Texture> mesh_textures;
             int mat_id = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids[0];
             if (mat_id >= 0 && mat_id < materials.size()) {
-                std::string tex_filename = materials[mat_id].diffuse_texname;
-                if (!tex_filename.empty()) {
-                    std::string full_path = directory + "/" + tex_filename;
-                    if (loaded_textures.find(full_path) == loaded_textures.end()) {
-                        Texture tex;
-                        tex.id = loadTexture(full_path.c_str());
-                        tex.type = "texture_diffuse1";
-                        tex.path = full_path;
-                        loaded_textures[full_path] = tex;
-                    }
-                    mesh_textures.push_back(loaded_textures[full_path]);
-                }
+                data.diffuseTexture = materials[mat_id].diffuse_texname;
             }
 
-            meshes.emplace_back(vertices, indices, mesh_textures);
-        }
-    }
-
-    unsigned int loadTexture(const char* path) {
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-        if (data) {
-            GLenum format = (nrComponents == 1) ? GL_RED :
-                (nrComponents == 3) ? GL_RGB : GL_RGBA;
+            MeshOptimizer::Stats stats = MeshOptimizer::optimize(data);
+            MeshSimplifier::buildLods(data);
+            report << path << " [" << shape.name << "] vertices " << stats.verticesBefore
+                << " -> " << stats.verticesAfter << ", ACMR " << stats.acmrBefore
+                << " -> " << stats.acmrAfter << ", LOD triangles";
+            for (const MeshLod& lod : data.lods)
+                report << " " << lod.indexCount / 3;
+            report << "\n";
 
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
-        }
-        else {
-            std::cerr << "Texture failed to load at path: " << path << std::endl;
-            stbi_image_free(data);
+            meshData.push_back(std::move(data));
         }
-        return textureID;
+        // One write per model so reports from parallel loads do not interleave.
+        std::cout << report.str() << std::flush;
     }
 };
 
@@ -0,0 +1,710 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBJ_PARSER_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// tiny_obj_loader.h's implementation section is not include-guarded, so
+// only pull in the declarations if nobody has yet.
+#ifndef TINY_OBJ_LOADER_H_
+#include "tiny_obj_loader.h"
+#endif
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+// Fast replacement for tinyobj::LoadObj with the same inputs and outputs
+// (vertices, normals, texcoords and triangulated shapes). The OBJ is
+// memory-mapped and cut into line-aligned chunks that are tokenized in
+// parallel with an SSE2 newline scan and a hand-written float parser.
+// A short serial pass then replays usemtl/mtllib/g/o/s in file order, so
+// shapes, names and material ids come out exactly as tinyobj builds them.
+// Materials are read with tinyobj's own MTL loader. Lines, points, tags,
+// vertex colors and weights are not produced. Polygons with more than four
+// corners are fanned, which matches tinyobj only for convex faces. A bare
+// "g" line starts an unnamed group, where tinyobj ignores it. With
+// the default thread count, a parse running on a ThreadPool worker splits
+// into at most its share of the cores, so concurrent loads do not
+// oversubscribe the machine.
+class ObjParser {
+public:
+    static bool load(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+        std::vector<tinyobj::material_t>* materials, std::string* warn, std::string* err,
+        const char* filename, const char* mtlBaseDir = nullptr, unsigned int threadCount = 0) {
+        attrib->vertices.clear();
+        attrib->normals.clear();
+        attrib->texcoords.clear();
+        attrib->colors.clear();
+        shapes->clear();
+
+        MappedFile file(filename);
+        if (!file.isOpen()) {
+            if (err)
+                *err += "Cannot open file [" + std::string(filename) + "]\n";
+            return false;
+        }
+
+        std::vector<Chunk> chunks = splitChunks(file.data(), file.size(), threadCount);
+        parallelFor(chunks.size(), [&](size_t i) { parseChunk(chunks[i]); });
+
+        for (const Chunk& chunk : chunks) {
+            if (!chunk.error.empty()) {
+                if (err)
+                    *err += chunk.error;
+                return false;
+            }
+        }
+
+        size_t positionCount = 0, normalCount = 0, texcoordCount = 0;
+        for (Chunk& chunk : chunks) {
+            chunk.positionBase = static_cast<int>(positionCount / 3);
+            chunk.normalBase = static_cast<int>(normalCount / 3);
+            chunk.texcoordBase = static_cast<int>(texcoordCount / 2);
+            positionCount += chunk.positions.size();
+            normalCount += chunk.normals.size();
+            texcoordCount += chunk.texcoords.size();
+        }
+        attrib->vertices.reserve(positionCount);
+        attrib->normals.reserve(normalCount);
+        attrib->texcoords.reserve(texcoordCount);
+        for (const Chunk& chunk : chunks) {
+            attrib->vertices.insert(attrib->vertices.end(), chunk.positions.begin(), chunk.positions.end());
+            attrib->normals.insert(attrib->normals.end(), chunk.normals.begin(), chunk.normals.end());
+            attrib->texcoords.insert(attrib->texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        }
+
+        std::string baseDir = mtlBaseDir ? mtlBaseDir : "";
+        resolveState(chunks, baseDir, materials, warn);
+        parallelFor(chunks.size(), [&](size_t i) { triangulate(chunks[i], attrib->vertices); });
+        buildShapes(chunks, shapes);
+
+        bool outOfBounds[3] = { false, false, false };
+        size_t degenerate = 0;
+        for (const Chunk& chunk : chunks) {
+            outOfBounds[0] = outOfBounds[0] || chunk.maxIndex[0] >= static_cast<int>(positionCount / 3);
+            outOfBounds[1] = outOfBounds[1] || chunk.maxIndex[1] >= static_cast<int>(normalCount / 3);
+            outOfBounds[2] = outOfBounds[2] || chunk.maxIndex[2] >= static_cast<int>(texcoordCount / 2);
+            degenerate += chunk.degenerateFaces;
+        }
+        if (warn) {
+            if (outOfBounds[0]) *warn += "Vertex indices out of bounds\n";
+            if (outOfBounds[1]) *warn += "Vertex normal indices out of bounds\n";
+            if (outOfBounds[2]) *warn += "Vertex texcoord indices out of bounds\n";
+            if (degenerate) *warn += "Degenerated face found\n";
+        }
+        return true;
+    }
+
+private:
+    // Below this size a chunk costs more to schedule than to parse.
+    static const size_t MIN_CHUNK_BYTES = 128 * 1024;
+
+    // A negative (relative) index points back from the current line, so it
+    // only becomes absolute once the chunk's base offsets are known.
+    struct RelativeCorner {
+        uint32_t corner;
+        uint8_t mask;
+    };
+
+    struct Face {
+        uint32_t firstCorner;
+        uint32_t cornerCount;
+    };
+
+    struct Command {
+        enum Type { Group, Object, UseMaterial, MaterialLibrary, Smoothing } type;
+        size_t face;
+        std::string argument;
+        int material = -1;
+        unsigned int smoothing = 0;
+    };
+
+    struct Chunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        std::string error;
+
+        std::vector<float> positions, normals, texcoords;
+        // Zero-based indices as written in the file, -1 when absent.
+        std::vector<tinyobj::index_t> corners;
+        std::vector<RelativeCorner> relative;
+        std::vector<Face> faces;
+        std::vector<Command> commands;
+        bool allTriangles = true;
+
+        int positionBase = 0, normalBase = 0, texcoordBase = 0;
+        int startMaterial = -1;
+        unsigned int startSmoothing = 0;
+        int maxIndex[3] = { -1, -1, -1 };
+        size_t degenerateFaces = 0;
+
+        std::vector<tinyobj::index_t> indices;
+        std::vector<int> materialIds;
+        std::vector<unsigned int> smoothingIds;
+        std::vector<uint32_t> faceTriangle;
+    };
+
+    template <typename Fn>
+    static void parallelFor(size_t count, Fn fn) {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < count; i++)
+            threads.emplace_back([&fn, i] { fn(i); });
+        if (count > 0)
+            fn(0);
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    static std::vector<Chunk> splitChunks(const char* data, size_t size, unsigned int threadCount) {
+        if (threadCount == 0) {
+            // On a pool worker the other workers may be parsing too, so
+            // take only this worker's share of the cores.
+            const ThreadPool* pool = ThreadPool::current();
+            threadCount = std::max(1u, std::thread::hardware_concurrency() / (pool ? pool->size() : 1u));
+        }
+        size_t count = std::max<size_t>(1, std::min<size_t>(threadCount, size / MIN_CHUNK_BYTES));
+
+        std::vector<Chunk> chunks;
+        const char* end = data + size;
+        const char* begin = data;
+        for (size_t i = 0; i < count && begin < end; i++) {
+            const char* split = (i + 1 == count) ? end : std::max(begin, data + size * (i + 1) / count);
+            if (split < end) {
+                const char* newline = findNewline(split, end);
+                split = newline < end ? newline + 1 : end;
+            }
+            chunks.emplace_back();
+            chunks.back().begin = begin;
+            chunks.back().end = split;
+            begin = split;
+        }
+        if (chunks.empty()) {
+            chunks.emplace_back();
+            chunks.back().begin = chunks.back().end = data;
+        }
+        return chunks;
+    }
+
+    static const char* findNewline(const char* p, const char* end) {
+#ifdef OBJ_PARSER_SSE2
+        const __m128i newline = _mm_set1_epi8('\n');
+        while (end - p >= 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+            if (mask != 0) {
+#ifdef _MSC_VER
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                return p + bit;
+#else
+                return p + __builtin_ctz(mask);
+#endif
+            }
+            p += 16;
+        }
+#endif
+        const void* hit = std::memchr(p, '\n', static_cast<size_t>(end - p));
+        return hit ? static_cast<const char*>(hit) : end;
+    }
+
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static bool isDigit(char c) {
+        return static_cast<unsigned>(c - '0') < 10;
+    }
+
+    // The scanners below do not bounds-check: they rely on every line
+    // ending in '\n', which stops all of them.
+    static const char* skipSpace(const char* p) {
+        while (isSpace(*p))
+            p++;
+        return p;
+    }
+
+    // Decimal float parser: the digits are accumulated in an integer and
+    // scaled by an exact power of ten, which is at most one rounding away
+    // from the nearest float. Long mantissas and anything unusual (inf,
+    // nan, hex) go through strtod.
+    static const char* parseFloat(const char* p, float& value) {
+        static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+        const char* start = p;
+        bool negative = *p == '-';
+        if (*p == '-' || *p == '+')
+            p++;
+
+        uint64_t mantissa = 0;
+        const char* digitsStart = p;
+        while (isDigit(*p))
+            mantissa = mantissa * 10 + static_cast<unsigned>(*p++ - '0');
+        int digits = static_cast<int>(p - digitsStart);
+        int exponent = 0;
+        if (*p == '.') {
+            const char* fraction = ++p;
+            while (isDigit(*p))
+                mantissa = mantissa * 10 + static_cast<unsigned>(*p++ - '0');
+            exponent = -static_cast<int>(p - fraction);
+            digits -= exponent;
+        }
+        if (digits == 0 || digits > 19)
+            return parseFloatSlow(start, value);
+
+        if (*p == 'e' || *p == 'E') {
+            const char* q = p + 1;
+            bool negativeExponent = *q == '-';
+            if (*q == '-' || *q == '+')
+                q++;
+            if (isDigit(*q)) {
+                int e = 0;
+                while (isDigit(*q))
+                    e = std::min(e * 10 + (*q++ - '0'), 10000);
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
+        }
+
+        double result = static_cast<double>(mantissa);
+        if (exponent < 0 && exponent >= -22)
+            result /= powers[-exponent];
+        else if (exponent > 0 && exponent <= 22)
+            result *= powers[exponent];
+        else if (exponent != 0)
+            result *= std::pow(10.0, exponent);
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    static const char* parseFloatSlow(const char* p, float& value) {
+        char buffer[64];
+        size_t length = 0;
+        while (length < sizeof(buffer) - 1 && !isSpace(p[length]) && p[length] != '\n')
+            buffer[length] = p[length], length++;
+        buffer[length] = '\0';
+        char* parsed = buffer;
+        value = static_cast<float>(std::strtod(buffer, &parsed));
+        return p + std::max<ptrdiff_t>(parsed - buffer, 1);
+    }
+
+    // Reads an OBJ index; returns nullptr when there are no digits.
+    static const char* parseIndex(const char* p, int& value) {
+        bool negative = *p == '-';
+        if (*p == '-' || *p == '+')
+            p++;
+        if (!isDigit(*p))
+            return nullptr;
+        int result = 0;
+        while (isDigit(*p))
+            result = result * 10 + (*p++ - '0');
+        value = negative ? -result : result;
+        return p;
+    }
+
+    // Rest of the line with surrounding whitespace trimmed.
+    static std::string restOfLine(const char* p, const char* end) {
+        p = skipSpace(p);
+        while (end > p && isSpace(end[-1]))
+            end--;
+        return std::string(p, end);
+    }
+
+    static bool startsWith(const char* p, const char* end, const char* keyword, size_t length) {
+        return static_cast<size_t>(end - p) > length && std::memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+    }
+
+    static void parseChunk(Chunk& chunk) {
+        const char* begin = chunk.begin;
+        const char* end = chunk.end;
+
+        // Only the file's last line can lack its '\n'; parse that one from
+        // a terminated copy.
+        std::string tail;
+        if (begin < end && end[-1] != '\n') {
+            const char* lastLine = end;
+            while (lastLine > begin && lastLine[-1] != '\n')
+                lastLine--;
+            tail.assign(lastLine, end);
+            tail += '\n';
+            end = lastLine;
+        }
+
+        parseLines(chunk, begin, end);
+        if (!tail.empty())
+            parseLines(chunk, tail.data(), tail.data() + tail.size());
+    }
+
+    static void parseLines(Chunk& chunk, const char* p, const char* end) {
+        while (p < end && chunk.error.empty()) {
+            const char* lineEnd = findNewline(p, end);
+            parseLine(chunk, skipSpace(p), lineEnd);
+            p = lineEnd + 1;
+        }
+    }
+
+    static void parseLine(Chunk& chunk, const char* p, const char* end) {
+        if (end - p == 1 && p[0] == 'g') {
+            // A bare "g" starts a new group with the default (empty) name.
+            Command command;
+            command.type = Command::Group;
+            command.face = chunk.faces.size();
+            chunk.commands.push_back(std::move(command));
+            return;
+        }
+        if (end - p < 2)
+            return;
+
+        if (p[0] == 'v') {
+            if (isSpace(p[1]))
+                parseFloats(chunk.positions, p + 2, 3);
+            else if (p[1] == 'n' && isSpace(p[2]))
+                parseFloats(chunk.normals, p + 3, 3);
+            else if (p[1] == 't' && isSpace(p[2]))
+                parseFloats(chunk.texcoords, p + 3, 2);
+            return;
+        }
+
+        if (p[0] == 'f' && isSpace(p[1])) {
+            parseFace(chunk, p + 2);
+            return;
+        }
+
+        Command command;
+        command.face = chunk.faces.size();
+        if (startsWith(p, end, "usemtl", 6)) {
+            command.type = Command::UseMaterial;
+            std::string name = restOfLine(p + 7, end);
+            command.argument = name.substr(0, name.find_first_of(" \t"));
+        }
+        else if (startsWith(p, end, "mtllib", 6)) {
+            command.type = Command::MaterialLibrary;
+            command.argument = restOfLine(p + 7, end);
+        }
+        else if (p[0] == 'g' && isSpace(p[1])) {
+            command.type = Command::Group;
+            command.argument = restOfLine(p + 2, end);
+        }
+        else if (p[0] == 'o' && isSpace(p[1])) {
+            command.type = Command::Object;
+            command.argument = restOfLine(p + 2, end);
+        }
+        else if (p[0] == 's' && isSpace(p[1])) {
+            command.type = Command::Smoothing;
+            command.argument = restOfLine(p + 2, end);
+        }
+        else {
+            return;
+        }
+        chunk.commands.push_back(std::move(command));
+    }
+
+    // Missing components read as zero, extra ones (w, colors) are ignored.
+    static void parseFloats(std::vector<float>& out, const char* p, int components) {
+        for (int i = 0; i < components; i++) {
+            float value = 0.0f;
+            p = skipSpace(p);
+            if (*p != '\n' && *p != '#')
+                p = parseFloat(p, value);
+            out.push_back(value);
+        }
+    }
+
+    static void parseFace(Chunk& chunk, const char* p) {
+        Face face;
+        face.firstCorner = static_cast<uint32_t>(chunk.corners.size());
+        int positionCount = static_cast<int>(chunk.positions.size() / 3);
+        int normalCount = static_cast<int>(chunk.normals.size() / 3);
+        int texcoordCount = static_cast<int>(chunk.texcoords.size() / 2);
+
+        for (;;) {
+            p = skipSpace(p);
+            if (*p == '\n' || *p == '#')
+                break;
+
+            int v = 0, vt = 0, vn = 0;
+            bool valid = (p = parseIndex(p, v)) != nullptr && v != 0;
+            if (valid && *p == '/') {
+                p++;
+                if (*p != '/')
+                    valid = (p = parseIndex(p, vt)) != nullptr && vt != 0;
+                if (valid && *p == '/')
+                    valid = (p = parseIndex(p + 1, vn)) != nullptr && vn != 0;
+            }
+            if (!valid || !(isSpace(*p) || *p == '\n' || *p == '#')) {
+                chunk.error = "Failed to parse `f' line (e.g. a zero value for vertex index or invalid relative vertex index).\n";
+                return;
+            }
+
+            tinyobj::index_t corner;
+            uint8_t relativeMask = 0;
+            corner.vertex_index = v > 0 ? v - 1 : positionCount + v;
+            corner.normal_index = vn > 0 ? vn - 1 : (vn < 0 ? normalCount + vn : -1);
+            corner.texcoord_index = vt > 0 ? vt - 1 : (vt < 0 ? texcoordCount + vt : -1);
+            relativeMask |= v < 0 ? 1 : 0;
+            relativeMask |= vn < 0 ? 2 : 0;
+            relativeMask |= vt < 0 ? 4 : 0;
+            if (relativeMask)
+                chunk.relative.push_back({ static_cast<uint32_t>(chunk.corners.size()), relativeMask });
+            chunk.corners.push_back(corner);
+        }
+
+        face.cornerCount = static_cast<uint32_t>(chunk.corners.size()) - face.firstCorner;
+        chunk.allTriangles = chunk.allTriangles && face.cornerCount == 3;
+        chunk.faces.push_back(face);
+    }
+
+    // Replays the state-changing commands in file order: loads material
+    // libraries as tinyobj does, and records the material and smoothing
+    // group in effect at every chunk start and after every command.
+    static void resolveState(std::vector<Chunk>& chunks, std::string baseDir,
+        std::vector<tinyobj::material_t>* materials, std::string* warn) {
+        if (!baseDir.empty()) {
+#ifdef _WIN32
+            const char separator = '\\';
+#else
+            const char separator = '/';
+#endif
+            if (baseDir.back() != separator)
+                baseDir += separator;
+        }
+        tinyobj::MaterialFileReader reader(baseDir);
+        std::map<std::string, int> materialMap;
+        std::set<std::string> loadedLibraries;
+
+        int material = -1;
+        unsigned int smoothing = 0;
+        for (Chunk& chunk : chunks) {
+            chunk.startMaterial = material;
+            chunk.startSmoothing = smoothing;
+            for (Command& command : chunk.commands) {
+                if (command.type == Command::MaterialLibrary) {
+                    loadMaterialLibraries(command.argument, reader, materials, materialMap, loadedLibraries, warn);
+                }
+                else if (command.type == Command::UseMaterial) {
+                    auto it = materialMap.find(command.argument);
+                    if (it != materialMap.end())
+                        material = it->second;
+                    else {
+                        material = -1;
+                        if (warn)
+                            *warn += "material [ '" + command.argument + "' ] not found in .mtl\n";
+                    }
+                }
+                else if (command.type == Command::Smoothing) {
+                    if (command.argument.compare(0, 3, "off") == 0)
+                        smoothing = 0;
+                    else if (!command.argument.empty())
+                        smoothing = static_cast<unsigned int>(std::max(0, std::atoi(command.argument.c_str())));
+                }
+                command.material = material;
+                command.smoothing = smoothing;
+            }
+        }
+    }
+
+    static void loadMaterialLibraries(const std::string& argument, tinyobj::MaterialFileReader& reader,
+        std::vector<tinyobj::material_t>* materials, std::map<std::string, int>& materialMap,
+        std::set<std::string>& loaded, std::string* warn) {
+        std::vector<std::string> names;
+        size_t start = 0;
+        while (start < argument.size()) {
+            size_t stop = argument.find(' ', start);
+            if (stop == std::string::npos)
+                stop = argument.size();
+            if (stop > start)
+                names.push_back(argument.substr(start, stop - start));
+            start = stop + 1;
+        }
+
+        for (const std::string& name : names) {
+            if (loaded.count(name))
+                return;
+            std::string warnMtl, errMtl;
+            bool ok = reader(name, materials, &materialMap, &warnMtl, &errMtl);
+            if (warn) {
+                *warn += warnMtl;
+                *warn += errMtl;
+            }
+            if (ok) {
+                loaded.insert(name);
+                return;
+            }
+        }
+        if (warn)
+            *warn += "Failed to load material file(s). Use default material.\n";
+    }
+
+    static void triangulate(Chunk& chunk, const std::vector<float>& positions) {
+        for (const RelativeCorner& relative : chunk.relative) {
+            tinyobj::index_t& corner = chunk.corners[relative.corner];
+            if (relative.mask & 1) corner.vertex_index += chunk.positionBase;
+            if (relative.mask & 2) corner.normal_index += chunk.normalBase;
+            if (relative.mask & 4) corner.texcoord_index += chunk.texcoordBase;
+        }
+        for (const tinyobj::index_t& corner : chunk.corners) {
+            chunk.maxIndex[0] = std::max(chunk.maxIndex[0], corner.vertex_index);
+            chunk.maxIndex[1] = std::max(chunk.maxIndex[1], corner.normal_index);
+            chunk.maxIndex[2] = std::max(chunk.maxIndex[2], corner.texcoord_index);
+        }
+
+        chunk.faceTriangle.resize(chunk.faces.size() + 1);
+        chunk.materialIds.reserve(chunk.faces.size());
+        chunk.smoothingIds.reserve(chunk.faces.size());
+        int material = chunk.startMaterial;
+        unsigned int smoothing = chunk.startSmoothing;
+        size_t nextCommand = 0;
+
+        // Triangle-only chunks (the common case) already hold their index
+        // stream; only the per-face attributes need filling in.
+        std::vector<tinyobj::index_t> corners;
+        if (chunk.allTriangles)
+            chunk.indices.swap(chunk.corners);
+        else {
+            corners.swap(chunk.corners);
+            chunk.indices.reserve(corners.size());
+        }
+
+        for (size_t f = 0; f < chunk.faces.size(); f++) {
+            while (nextCommand < chunk.commands.size() && chunk.commands[nextCommand].face <= f) {
+                material = chunk.commands[nextCommand].material;
+                smoothing = chunk.commands[nextCommand].smoothing;
+                nextCommand++;
+            }
+            chunk.faceTriangle[f] = static_cast<uint32_t>(chunk.materialIds.size());
+
+            if (chunk.allTriangles) {
+                chunk.materialIds.push_back(material);
+                chunk.smoothingIds.push_back(smoothing);
+                continue;
+            }
+
+            const Face& face = chunk.faces[f];
+            const tinyobj::index_t* c = &corners[face.firstCorner];
+            if (face.cornerCount < 3) {
+                chunk.degenerateFaces++;
+                continue;
+            }
+
+            if (face.cornerCount == 4) {
+                // Split along the shorter diagonal, like tinyobj.
+                size_t v[4];
+                bool valid = true;
+                for (int k = 0; k < 4; k++) {
+                    v[k] = static_cast<size_t>(c[k].vertex_index);
+                    valid = valid && c[k].vertex_index >= 0 && 3 * v[k] + 2 < positions.size();
+                }
+                if (!valid) {
+                    chunk.degenerateFaces++;
+                    continue;
+                }
+                float d02 = 0.0f, d13 = 0.0f;
+                for (int k = 0; k < 3; k++) {
+                    float a = positions[3 * v[2] + k] - positions[3 * v[0] + k];
+                    float b = positions[3 * v[3] + k] - positions[3 * v[1] + k];
+                    d02 += a * a;
+                    d13 += b * b;
+                }
+                if (d02 < d13) {
+                    pushTriangle(chunk, c[0], c[1], c[2], material, smoothing);
+                    pushTriangle(chunk, c[0], c[2], c[3], material, smoothing);
+                }
+                else {
+                    pushTriangle(chunk, c[0], c[1], c[3], material, smoothing);
+                    pushTriangle(chunk, c[1], c[2], c[3], material, smoothing);
+                }
+                continue;
+            }
+
+            for (uint32_t k = 1; k + 1 < face.cornerCount; k++)
+                pushTriangle(chunk, c[0], c[k], c[k + 1], material, smoothing);
+        }
+        chunk.faceTriangle[chunk.faces.size()] = static_cast<uint32_t>(chunk.materialIds.size());
+    }
+
+    static void pushTriangle(Chunk& chunk, const tinyobj::index_t& a, const tinyobj::index_t& b, const tinyobj::index_t& c,
+        int material, unsigned int smoothing) {
+        chunk.indices.push_back(a);
+        chunk.indices.push_back(b);
+        chunk.indices.push_back(c);
+        chunk.materialIds.push_back(material);
+        chunk.smoothingIds.push_back(smoothing);
+    }
+
+    // Cuts the per-chunk triangle streams into shapes at every g/o line.
+    static void buildShapes(std::vector<Chunk>& chunks, std::vector<tinyobj::shape_t>* shapes) {
+        tinyobj::shape_t shape;
+        std::string name;
+
+        auto append = [&shape](Chunk& chunk, size_t first, size_t last) {
+            if (first >= last)
+                return;
+            if (shape.mesh.indices.empty() && first == 0 && last == chunk.materialIds.size()) {
+                // A whole chunk opening a shape is moved rather than copied.
+                shape.mesh.indices = std::move(chunk.indices);
+                shape.mesh.num_face_vertices.assign(last, 3u);
+                shape.mesh.material_ids = std::move(chunk.materialIds);
+                shape.mesh.smoothing_group_ids = std::move(chunk.smoothingIds);
+                return;
+            }
+            shape.mesh.indices.insert(shape.mesh.indices.end(), chunk.indices.begin() + 3 * first, chunk.indices.begin() + 3 * last);
+            shape.mesh.num_face_vertices.insert(shape.mesh.num_face_vertices.end(), last - first, 3u);
+            shape.mesh.material_ids.insert(shape.mesh.material_ids.end(), chunk.materialIds.begin() + first, chunk.materialIds.begin() + last);
+            shape.mesh.smoothing_group_ids.insert(shape.mesh.smoothing_group_ids.end(),
+                chunk.smoothingIds.begin() + first, chunk.smoothingIds.begin() + last);
+        };
+        auto flush = [&shape, &name, shapes]() {
+            if (!shape.mesh.indices.empty()) {
+                shape.name = name;
+                shapes->push_back(std::move(shape));
+            }
+            shape = tinyobj::shape_t();
+        };
+
+        for (Chunk& chunk : chunks) {
+            size_t cursor = 0;
+            for (const Command& command : chunk.commands) {
+                if (command.type != Command::Group && command.type != Command::Object)
+                    continue;
+                size_t split = chunk.faceTriangle[command.face];
+                append(chunk, cursor, split);
+                cursor = split;
+                flush();
+                name = command.type == Command::Group ? joinGroupNames(command.argument) : command.argument;
+            }
+            append(chunk, cursor, chunk.materialIds.size());
+        }
+        flush();
+    }
+
+    static std::string joinGroupNames(const std::string& argument) {
+        std::string joined;
+        size_t start = 0;
+        while (start < argument.size()) {
+            size_t stop = argument.find_first_of(" \t", start);
+            if (stop == std::string::npos)
+                stop = argument.size();
+            if (stop > start)
+                joined += (joined.empty() ? "" : " ") + argument.substr(start, stop - start);
+            start = stop + 1;
+        }
+        return joined;
+    }
+};
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Occlusion culling against a low-resolution depth prepass. Between begin()
+// and end() the frame's occluders are drawn, with the frame's own
+// view-projection, into a depth target BASE_WIDTH texels wide; end() starts
+// an asynchronous read into one of READBACKS pixel buffers and fences it.
+// begin() maps the newest readback whose fence has signaled, without
+// waiting, and builds a max-depth pyramid from it on the CPU. The pyramid
+// is a frame or more old, so it is only used while it still describes the
+// current frame: visible() tests against it only when the frame's
+// view-projection matches the one it was drawn with, and the caller must
+// invalidate() it whenever the set of occluders changes. Occluders must be
+// static; anything that moves belongs in the tested items only.
+//
+// Tests are conservative: the base level is dilated by one texel so that
+// occluder edges rasterized at low resolution never hide anything, boxes
+// crossing the near plane count as visible, and while the camera moves,
+// until a fence has signaled, once the pyramid is more than READBACKS
+// frames old, or when disabled, everything is visible.
+class OcclusionCuller {
+public:
+    static constexpr int BASE_WIDTH = 256;
+    static constexpr int READBACKS = 3;
+    // Largest difference per view-projection element for which a pyramid
+    // still counts as drawn from the current viewpoint.
+    static constexpr float MATRIX_EPSILON = 1e-5f;
+
+    bool enabled = true;
+
+    OcclusionCuller() = default;
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    ~OcclusionCuller() {
+        release();
+    }
+
+    // Picks up the newest finished readback, then binds the depth target
+    // and clears it. When this returns true, draw the occluders and call
+    // end(), which restores the previous framebuffer and viewport; when it
+    // returns false (disabled, or an empty viewport) nothing is bound and
+    // the occluders must not be drawn.
+    bool begin(const glm::mat4& viewProjection, int viewportWidth, int viewportHeight) {
+        frame++;
+        if (!enabled || viewportWidth <= 0 || viewportHeight <= 0) {
+            ready = current = false;
+            return false;
+        }
+        // Saved first: creating the target unbinds the current framebuffer.
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &savedFramebuffer);
+        int height = std::max(1, BASE_WIDTH * viewportHeight / viewportWidth);
+        if (height != targetHeight)
+            createTarget(height);
+
+        resolve();
+        if (ready && frame - resolvedFrame > READBACKS)
+            ready = false;
+        current = ready && sameMatrix(matrix, viewProjection);
+
+        frameMatrix = viewProjection;
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, BASE_WIDTH, targetHeight);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        active = true;
+        return true;
+    }
+
+    void end() {
+        if (!active)
+            return;
+        // A readback still unfinished after READBACKS frames is dropped.
+        Readback& readback = readbacks[nextReadback];
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+        glReadPixels(0, 0, BASE_WIDTH, targetHeight, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback.matrix = frameMatrix;
+        readback.frame = frame;
+        readback.viewportPixels = static_cast<float>(savedViewport[2]) * savedViewport[3];
+        nextReadback = (nextReadback + 1) % READBACKS;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+        active = false;
+    }
+
+    // Drops the pyramid and every readback in flight; call when occluders
+    // appear, disappear or move.
+    void invalidate() {
+        for (Readback& readback : readbacks) {
+            if (readback.fence) {
+                glDeleteSync(readback.fence);
+                readback.fence = nullptr;
+            }
+        }
+        ready = current = false;
+    }
+
+    // Deletes the depth target and readback buffers; call before the GL
+    // context goes away. The next begin() creates them again.
+    void release() {
+        if (FBO != 0) {
+            glDeleteFramebuffers(1, &FBO);
+            glDeleteTextures(1, &depthTexture);
+            FBO = depthTexture = 0;
+        }
+        for (Readback& readback : readbacks) {
+            if (readback.fence)
+                glDeleteSync(readback.fence);
+            if (readback.PBO != 0)
+                glDeleteBuffers(1, &readback.PBO);
+            readback = Readback();
+        }
+        nextReadback = 0;
+        targetHeight = 0;
+        ready = current = false;
+    }
+
+    // Whether an object with these object-space bounds may be visible. When
+    // it is not, screenPixels receives the area its box covers on screen,
+    // in prepass texels scaled to the viewport.
+    bool visible(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float* screenPixels = nullptr) {
+        if (!enabled || !current)
+            return true;
+
+        glm::mat4 clip = matrix * transform;
+        glm::vec3 ndcMin(1.0f), ndcMax(-1.0f);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 p((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y,
+                (corner & 4) ? boundsMax.z : boundsMin.z);
+            glm::vec4 c = clip * glm::vec4(p, 1.0f);
+            if (c.w <= 1e-4f)
+                return true;
+            glm::vec3 ndc = glm::vec3(c) / c.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+        if (ndcMin.z < -1.0f)
+            return true;
+
+        int x0 = std::max(0, static_cast<int>(std::floor((ndcMin.x * 0.5f + 0.5f) * BASE_WIDTH)));
+        int y0 = std::max(0, static_cast<int>(std::floor((ndcMin.y * 0.5f + 0.5f) * targetHeight)));
+        int x1 = std::min(BASE_WIDTH - 1, static_cast<int>(std::floor((ndcMax.x * 0.5f + 0.5f) * BASE_WIDTH)));
+        int y1 = std::min(targetHeight - 1, static_cast<int>(std::floor((ndcMax.y * 0.5f + 0.5f) * targetHeight)));
+        if (x0 > x1 || y0 > y1)
+            return true;
+
+        // Finest level at which the rectangle spans at most four texels per
+        // axis, so at most sixteen texels are read.
+        int level = 0;
+        while (level + 1 < static_cast<int>(levels.size()) && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+            level++;
+        const Level& hiz = levels[level];
+        float farthest = 0.0f;
+        for (int y = y0 >> level; y <= (y1 >> level); y++) {
+            for (int x = x0 >> level; x <= (x1 >> level); x++)
+                farthest = std::max(farthest, hiz.depth[y * hiz.width + x]);
+        }
+
+        float nearest = ndcMin.z * 0.5f + 0.5f;
+        if (nearest <= farthest)
+            return true;
+        if (screenPixels)
+            *screenPixels = (x1 - x0 + 1) * (y1 - y0 + 1) * pixelScale;
+        return false;
+    }
+
+private:
+    struct Level {
+        int width;
+        int height;
+        std::vector<float> depth;
+    };
+
+    struct Readback {
+        unsigned int PBO = 0;
+        GLsync fence = nullptr;    // null once read or dropped
+        glm::mat4 matrix = glm::mat4(1.0f);
+        uint64_t frame = 0;
+        float viewportPixels = 0.0f;
+    };
+
+    unsigned int FBO = 0, depthTexture = 0;
+    Readback readbacks[READBACKS];
+    int nextReadback = 0;
+    int targetHeight = 0;
+    GLint savedViewport[4] = {};
+    GLint savedFramebuffer = 0;
+    glm::mat4 frameMatrix = glm::mat4(1.0f);
+    // The pyramid's view-projection and the frame its prepass was drawn in.
+    glm::mat4 matrix = glm::mat4(1.0f);
+    uint64_t frame = 0;
+    uint64_t resolvedFrame = 0;
+    float pixelScale = 1.0f;
+    bool active = false;
+    bool ready = false;
+    bool current = false;      // ready and drawn with this frame's matrix
+    std::vector<Level> levels;
+    std::vector<float> depthCopy;
+
+    void createTarget(int height) {
+        release();
+        targetHeight = height;
+
+        glGenTextures(1, &depthTexture);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, BASE_WIDTH, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        for (Readback& readback : readbacks) {
+            glGenBuffers(1, &readback.PBO);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+            glBufferData(GL_PIXEL_PACK_BUFFER, BASE_WIDTH * height * sizeof(float), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        levels.clear();
+        for (int w = BASE_WIDTH, h = height;; w = (w + 1) / 2, h = (h + 1) / 2) {
+            levels.push_back({ w, h, std::vector<float>(static_cast<size_t>(w) * h) });
+            if (w == 1 && h == 1)
+                break;
+        }
+        depthCopy.resize(static_cast<size_t>(BASE_WIDTH) * height);
+    }
+
+    static bool sameMatrix(const glm::mat4& a, const glm::mat4& b) {
+        for (int column = 0; column < 4; column++) {
+            glm::vec4 difference = glm::abs(a[column] - b[column]);
+            if (std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)) > MATRIX_EPSILON)
+                return false;
+        }
+        return true;
+    }
+
+    // Builds the pyramid from the newest readback whose fence has signaled
+    // and forgets the older ones; never waits.
+    void resolve() {
+        Readback* newest = nullptr;
+        for (Readback& readback : readbacks) {
+            if (!readback.fence || (newest && readback.frame < newest->frame))
+                continue;
+            GLenum status = glClientWaitSync(readback.fence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+                newest = &readback;
+        }
+        if (!newest)
+            return;
+        for (Readback& readback : readbacks) {
+            if (readback.fence && readback.frame <= newest->frame) {
+                glDeleteSync(readback.fence);
+                readback.fence = nullptr;
+            }
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, newest->PBO);
+        const float* mapped = static_cast<const float*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+            depthCopy.size() * sizeof(float), GL_MAP_READ_BIT));
+        if (mapped) {
+            std::copy(mapped, mapped + depthCopy.size(), depthCopy.begin());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (!mapped)
+            return;
+
+        // Level 0 is the 3x3 maximum of the prepass, each further level
+        // the maximum of the (up to) 2x2 texels below it.
+        Level& base = levels[0];
+        for (int y = 0; y < base.height; y++) {
+            for (int x = 0; x < base.width; x++) {
+                float farthest = 0.0f;
+                for (int dy = std::max(0, y - 1); dy <= std::min(base.height - 1, y + 1); dy++) {
+                    for (int dx = std::max(0, x - 1); dx <= std::min(base.width - 1, x + 1); dx++)
+                        farthest = std::max(farthest, depthCopy[dy * base.width + dx]);
+                }
+                base.depth[y * base.width + x] = farthest;
+            }
+        }
+        for (size_t i = 1; i < levels.size(); i++) {
+            const Level& below = levels[i - 1];
+            Level& level = levels[i];
+            for (int y = 0; y < level.height; y++) {
+                for (int x = 0; x < level.width; x++) {
+                    int bx = x * 2, by = y * 2;
+                    int bx1 = std::min(bx + 1, below.width - 1), by1 = std::min(by + 1, below.height - 1);
+                    level.depth[y * level.width + x] = std::max(
+                        std::max(below.depth[by * below.width + bx], below.depth[by * below.width + bx1]),
+                        std::max(below.depth[by1 * below.width + bx], below.depth[by1 * below.width + bx1]));
+                }
+            }
+        }
+
+        matrix = newest->matrix;
+        resolvedFrame = newest->frame;
+        pixelScale = newest->viewportPixels / (BASE_WIDTH * targetHeight);
+        ready = true;
+    }
+};
+
+#endif
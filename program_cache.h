@@ -0,0 +1,144 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "gl_ext.h"
+#include "hash.h"
+#include "mapped_file.h"
+
+// On-disk cache of linked program binaries, one file per program in
+// directory, named after the hash of the program's sources. Each entry
+// records the driver it came from (vendor, renderer and version strings);
+// an entry from another driver, or one the driver rejects, is a miss and
+// the caller compiles from source, after which store() replaces it.
+// Main thread only, like every other GL call.
+class ProgramCache {
+public:
+    // Where binaries are kept; empty disables the cache.
+    static inline std::string directory;
+
+    // Programs loaded from a binary and programs compiled from source.
+    static inline int hits = 0;
+    static inline int misses = 0;
+
+    static bool enabled() {
+        return GLExt::programBinary && !directory.empty();
+    }
+
+    // Loads the binary stored for sourceKey into program. Returns whether
+    // the program is now linked; if not it is left without a binary and
+    // may be compiled and linked as usual.
+    static bool load(uint64_t sourceKey, GLuint program) {
+        if (!enabled()) {
+            misses++;
+            return false;
+        }
+        MappedFile blob(path(sourceKey));
+        const Header* header = blob.size() >= sizeof(Header) ? reinterpret_cast<const Header*>(blob.data()) : nullptr;
+        if (!header || std::memcmp(header->magic, MAGIC, 4) != 0 || header->version != VERSION ||
+            header->sourceKey != sourceKey || header->driverKey != driverKey() ||
+            blob.size() - sizeof(Header) < header->length) {
+            misses++;
+            return false;
+        }
+
+        GLExt::programBinaryLoad(program, header->format, blob.data() + sizeof(Header), static_cast<GLsizei>(header->length));
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            misses++;
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    // Call before linking a program that will be passed to store().
+    static void markRetrievable(GLuint program) {
+        if (enabled())
+            GLExt::programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    static void store(uint64_t sourceKey, GLuint program) {
+        if (!enabled())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        std::vector<char> out(sizeof(Header) + length);
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, 4);
+        header.version = VERSION;
+        header.sourceKey = sourceKey;
+        header.driverKey = driverKey();
+        GLsizei written = 0;
+        GLExt::getProgramBinary(program, length, &written, &header.format, out.data() + sizeof(Header));
+        header.length = static_cast<uint32_t>(written);
+        std::memcpy(out.data(), &header, sizeof(Header));
+        out.resize(sizeof(Header) + written);
+
+        // Same temporary-and-rename scheme as the mesh cache.
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        std::string target = path(sourceKey);
+        std::string temp = target + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+                std::cerr << "WARN: could not write program cache " << temp << std::endl;
+                return;
+            }
+        }
+        std::filesystem::rename(temp, target, ec);
+        if (ec) {
+            std::cerr << "WARN: could not write program cache " << target << ": " << ec.message() << std::endl;
+            std::filesystem::remove(temp, ec);
+        }
+    }
+
+private:
+    static constexpr char MAGIC[4] = { 'V', 'M', 'P', 'B' };
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceKey;
+        uint64_t driverKey;
+        GLenum format;
+        uint32_t length;
+    };
+
+    static std::string path(uint64_t sourceKey) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.glprog", static_cast<unsigned long long>(sourceKey));
+        return directory + "/" + name;
+    }
+
+    static uint64_t driverKey() {
+        static const uint64_t key = [] {
+            uint64_t hash = hashString("");
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+                const char* text = reinterpret_cast<const char*>(glGetString(name));
+                hash = hashString(text ? text : "", hash);
+                hash = hashBytes("\n", 1, hash);
+            }
+            return hash;
+        }();
+        return key;
+    }
+};
+
+#endif
@@ -0,0 +1,381 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "frustum_culler.h"
+#include "gl_ext.h"
+#include "gpu_profiler.h"
+#include "instance_buffer.h"
+#include "occlusion_culler.h"
+#include "shaderClass.h"
+#include "transform_buffer.h"
+
+// Everything one draw call needs. Geometry is an index range of a VAO, or a
+// vertex range when indexType is 0. The material is the texture on unit 0,
+// bound when useTexture is set; shader is then the TEXTURED variant, so
+// programs carry no material uniforms. transform is the object's
+// TransformBuffer slot; it, color and posOffset/posScale, which undo the
+// packed vertex quantization (identity for float vertices), are
+// per-instance vertex data.
+struct DrawItem {
+    const Shader* shader = nullptr;
+    unsigned int vao = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLsizei count = 0;
+    size_t first = 0;
+    GLint baseVertex = 0;
+    unsigned int texture = 0;
+    bool useTexture = false;
+    glm::vec3 color = glm::vec3(1.0f);
+    glm::vec3 posOffset = glm::vec3(0.0f);
+    glm::vec3 posScale = glm::vec3(1.0f);
+    uint32_t transform = TransformBuffer::IDENTITY;
+    // Object-space bounds for frustum culling; items without are always drawn.
+    bool hasBounds = false;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+};
+
+// Per-frame counters. "Draws" are GL draw calls and "commands" the
+// instanced batches they issued, more than one per call with multi-draw
+// indirect; "instances" is how many items those covered. "Skipped" counts
+// state changes the queue did not issue because the value was already
+// current.
+struct RenderStats {
+    int draws = 0;
+    int commands = 0;
+    int instances = 0;
+    int programBinds = 0;
+    int vaoBinds = 0;
+    int textureBinds = 0;
+    int skipped = 0;
+    int visible = 0;
+    int culled = 0;
+    int occluded = 0;
+    int occludedTriangles = 0;
+    float occludedPixels = 0.0f;
+    float cullMicroseconds = 0.0f;
+};
+
+// Collects the frame's opaque draws, drops those outside the view frustum
+// or, when an OcclusionCuller is attached, hidden behind the frame's
+// occluders, and issues the rest in one pass, sorted by a 64-bit key: program (8
+// bits), texture (16), VAO (16), index range (8), then depth (16) so that
+// within one state bucket nearer items draw first.
+// Runs of items that differ only in per-instance data become a single
+// instanced batch. On GL 4.3 consecutive batches with the same program,
+// VAO and texture go out as one glMultiDrawElementsIndirect; since models
+// share their format's GeometryPool VAO, that is one call per texture.
+// Program, VAO and texture are only touched when they change.
+//
+// Items can be grouped into named passes with beginPass(). While an
+// attached GpuProfiler is timing, passes are drawn one after another in the
+// order they were begun, each sorted on its own and timed as a section;
+// that costs state changes and batches that would otherwise span passes.
+// Otherwise the pass is ignored and the whole frame sorts as one.
+class RenderQueue {
+public:
+    void submit(const DrawItem& item) {
+        items.push_back(item);
+        itemPasses.push_back(pass);
+    }
+
+    // Items submitted from here until the next call belong to pass name,
+    // which must outlive the flush.
+    void beginPass(const char* name) {
+        passNames.push_back(name);
+        pass = static_cast<uint32_t>(passNames.size() - 1);
+    }
+
+    // Draw through glMultiDrawElementsIndirect where the context has it;
+    // off means one instanced draw per batch, the GL 3.3 path.
+    bool useMultiDrawIndirect = true;
+
+    // Tested after the frustum for items with bounds; may be null.
+    OcclusionCuller* occlusion = nullptr;
+
+    // Times each named pass while enabled; may be null.
+    GpuProfiler* profiler = nullptr;
+
+    ~RenderQueue() {
+        release();
+    }
+
+    void flush(const glm::mat4& viewProjection, const glm::vec3& cameraPos, float farPlane) {
+        stats = RenderStats();
+        const TransformBuffer& transforms = TransformBuffer::instance();
+        cullItems(viewProjection);
+        bool splitPasses = profiler && profiler->enabled;
+
+        keys.clear();
+        for (uint32_t i = 0; i < items.size(); i++) {
+            if (!drawn[i])
+                continue;
+            const DrawItem& item = items[i];
+            const glm::mat4& transform = transforms.transform(item.transform);
+            float distance = glm::length(glm::vec3(transform[3]) - cameraPos);
+            uint64_t depth = static_cast<uint64_t>(glm::clamp(distance / farPlane, 0.0f, 1.0f) * 0xFFFF);
+            uint64_t range = (item.first ^ (static_cast<size_t>(item.count) << 3)) & 0xFF;
+            uint64_t key = (uint64_t(item.shader->ID & 0xFF) << 56) | (uint64_t(item.texture & 0xFFFF) << 40) |
+                (uint64_t(item.vao & 0xFFFF) << 24) | (range << 16) | depth;
+            keys.push_back({ key, i, splitPasses ? itemPasses[i] : UNNAMED });
+        }
+        std::sort(keys.begin(), keys.end(), [](const SortKey& a, const SortKey& b) {
+            if (a.pass != b.pass)
+                return a.pass < b.pass;
+            return a.key != b.key ? a.key < b.key : a.index < b.index;
+        });
+
+        // All instance data for the frame goes up in one upload.
+        instances.clear();
+        for (const SortKey& sorted : keys) {
+            const DrawItem& item = items[sorted.index];
+            instances.push_back({ item.transform, glm::vec4(item.color, 1.0f), item.posOffset, item.posScale });
+        }
+        InstanceBuffer& instanceBuffer = InstanceBuffer::instance();
+        if (!instances.empty())
+            instanceBuffer.upload(instances.data(), instances.size());
+
+        batches.clear();
+        for (size_t start = 0, end; start < keys.size(); start = end) {
+            end = start + 1;
+            while (end < keys.size() && keys[end].pass == keys[start].pass &&
+                sameBatch(items[keys[start].index], items[keys[end].index]))
+                end++;
+            batches.push_back({ start, end });
+        }
+
+        // With multi-draw indirect every indexed batch becomes a command
+        // whose baseInstance selects its instances, and all commands for
+        // the frame go up in one upload as well.
+        bool indirect = useMultiDrawIndirect && GLExt::multiDrawIndirect;
+        if (indirect)
+            uploadCommands();
+
+        // Code outside the queue may have changed any of this since the
+        // last flush, so the first use of each value per frame is issued.
+        const Shader* shader = nullptr;
+        unsigned int vao = ~0u;
+        unsigned int texture = ~0u;
+        size_t attributeBase = ~size_t(0);
+        const char* profiledPass = nullptr;
+
+        size_t group = 0;
+        while (group < batches.size()) {
+            const SortKey& first = keys[batches[group].start];
+            const DrawItem& item = items[first.index];
+            size_t groupEnd = group + 1;
+            if (indirect && item.indexType != 0) {
+                while (groupEnd < batches.size() && keys[batches[groupEnd].start].pass == first.pass &&
+                    sameState(item, items[keys[batches[groupEnd].start].index]))
+                    groupEnd++;
+            }
+
+            const char* passName = first.pass < passNames.size() ? passNames[first.pass] : nullptr;
+            if (profiler && passName != profiledPass) {
+                if (profiledPass)
+                    profiler->pop();
+                if (passName)
+                    profiler->push(passName);
+                profiledPass = passName;
+            }
+
+            if (item.shader != shader) {
+                shader = item.shader;
+                shader->use();
+                stats.programBinds++;
+            }
+            else {
+                stats.skipped++;
+            }
+
+            if (item.vao != vao) {
+                vao = item.vao;
+                glBindVertexArray(vao);
+                attributeBase = ~size_t(0);
+                stats.vaoBinds++;
+            }
+            else {
+                stats.skipped++;
+            }
+
+            // Indirect commands carry their own baseInstance; everything
+            // else needs the attributes moved to its first instance.
+            size_t base = indirect && item.indexType != 0 ? 0 : batches[group].start;
+            if (base != attributeBase) {
+                instanceBuffer.bindAttributes(base);
+                attributeBase = base;
+            }
+
+            if (item.useTexture) {
+                if (item.texture != texture) {
+                    texture = item.texture;
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, texture);
+                    stats.textureBinds++;
+                }
+                else {
+                    stats.skipped++;
+                }
+            }
+
+            if (indirect && item.indexType != 0) {
+                GLExt::multiDrawElementsIndirect(item.mode, item.indexType,
+                    (void*)(group * sizeof(DrawElementsIndirectCommand)), static_cast<GLsizei>(groupEnd - group), 0);
+            }
+            else {
+                GLsizei instanceCount = static_cast<GLsizei>(batches[group].end - batches[group].start);
+                if (item.indexType == 0) {
+                    glDrawArraysInstanced(item.mode, static_cast<GLint>(item.first), item.count, instanceCount);
+                }
+                else {
+                    size_t indexSize = item.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+                    glDrawElementsInstancedBaseVertex(item.mode, item.count, item.indexType,
+                        (void*)(item.first * indexSize), instanceCount, item.baseVertex);
+                }
+            }
+            stats.draws++;
+            stats.commands += static_cast<int>(groupEnd - group);
+            stats.instances += static_cast<int>(batches[groupEnd - 1].end - batches[group].start);
+            group = groupEnd;
+        }
+
+        if (profiler && profiledPass)
+            profiler->pop();
+        if (indirect)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+        clear();
+    }
+
+    // Drops everything submitted since the last flush() without drawing it.
+    void clear() {
+        items.clear();
+        itemPasses.clear();
+        passNames.clear();
+        pass = UNNAMED;
+    }
+
+    // Deletes the indirect buffer; call before the GL context goes away.
+    // The next flush() creates it again.
+    void release() {
+        if (indirectBuffer != 0)
+            glDeleteBuffers(1, &indirectBuffer);
+        indirectBuffer = 0;
+    }
+
+    // Counters of the last flush().
+    const RenderStats& lastStats() const {
+        return stats;
+    }
+
+private:
+    // Items submitted before any beginPass().
+    static constexpr uint32_t UNNAMED = ~0u;
+
+    struct SortKey {
+        uint64_t key;
+        uint32_t index;
+        uint32_t pass;
+    };
+
+    // Items [start, end) of the sorted keys, drawn as one instanced batch.
+    struct Batch {
+        size_t start;
+        size_t end;
+    };
+
+    std::vector<DrawItem> items;
+    std::vector<uint32_t> itemPasses;
+    std::vector<const char*> passNames;
+    uint32_t pass = UNNAMED;
+    std::vector<SortKey> keys;
+    std::vector<InstanceData> instances;
+    std::vector<Batch> batches;
+    std::vector<DrawElementsIndirectCommand> commands;
+    FrustumCuller culler;
+    std::vector<uint8_t> drawn;
+    unsigned int indirectBuffer = 0;
+    size_t indirectCapacity = 0;
+    RenderStats stats;
+
+    // One culler entry per item, in item order. Unbounded items get bounds
+    // no plane can reject and are never tested for occlusion.
+    void cullItems(const glm::mat4& viewProjection) {
+        auto start = std::chrono::steady_clock::now();
+        const TransformBuffer& transforms = TransformBuffer::instance();
+        culler.clear();
+        for (const DrawItem& item : items) {
+            if (item.hasBounds)
+                culler.add(transforms.transform(item.transform), item.boundsMin, item.boundsMax, item.boundsRadius);
+            else
+                culler.addWorld(glm::vec3(0.0f), glm::vec3(1e30f), 1e30f);
+        }
+        culler.cull(Frustum::fromMatrix(viewProjection));
+        stats.visible = static_cast<int>(culler.visibleCount());
+        stats.culled = static_cast<int>(items.size()) - stats.visible;
+
+        drawn.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++) {
+            const DrawItem& item = items[i];
+            drawn[i] = culler.visible(i) ? 1 : 0;
+            float pixels = 0.0f;
+            if (drawn[i] && item.hasBounds && occlusion &&
+                !occlusion->visible(transforms.transform(item.transform), item.boundsMin, item.boundsMax, &pixels)) {
+                drawn[i] = 0;
+                stats.occluded++;
+                stats.occludedTriangles += item.mode == GL_TRIANGLES ? item.count / 3 : 0;
+                stats.occludedPixels += pixels;
+            }
+        }
+        stats.visible -= stats.occluded;
+        std::chrono::duration<float, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        stats.cullMicroseconds = elapsed.count();
+    }
+
+    // Everything but the per-instance data must match.
+    static bool sameBatch(const DrawItem& a, const DrawItem& b) {
+        return sameState(a, b) && a.count == b.count && a.first == b.first && a.baseVertex == b.baseVertex;
+    }
+
+    // Batches that can share one multi-draw: same program, geometry buffers,
+    // primitive and material.
+    static bool sameState(const DrawItem& a, const DrawItem& b) {
+        return a.shader == b.shader && a.vao == b.vao && a.mode == b.mode && a.indexType == b.indexType &&
+            a.useTexture == b.useTexture && (!a.useTexture || a.texture == b.texture);
+    }
+
+    // One command per batch, so batch i is command i. Non-indexed batches
+    // get a placeholder that is never drawn.
+    void uploadCommands() {
+        commands.clear();
+        for (const Batch& batch : batches) {
+            const DrawItem& item = items[keys[batch.start].index];
+            DrawElementsIndirectCommand command;
+            command.count = static_cast<GLuint>(item.count);
+            command.instanceCount = static_cast<GLuint>(batch.end - batch.start);
+            command.firstIndex = static_cast<GLuint>(item.first);
+            command.baseVertex = item.baseVertex;
+            command.baseInstance = static_cast<GLuint>(batch.start);
+            commands.push_back(command);
+        }
+        if (indirectBuffer == 0)
+            glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        while (indirectCapacity < commands.size())
+            indirectCapacity = indirectCapacity == 0 ? 256 : indirectCapacity * 2;
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCapacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        if (!commands.empty())
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    }
+};
+
+#endif
@@ -5,16 +5,25 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "model.h"
 #include "shaderClass.h"
+#include "transform_buffer.h"
 
 class Robot {
 public:
     glm::vec3 position;
     float rotationY;
-    Model body;
-    Model arm;
+    std::unique_ptr<Model> body;
+    std::unique_ptr<Model> arm;
+    TransformSlot bodySlot;
+    TransformSlot armSlot;
 
     Robot(const std::string& bodyPath, const std::string& armPath, glm::vec3 startPos)
-        : body(bodyPath), arm(armPath), position(startPos), rotationY(0.0f) {
+        : position(startPos), rotationY(0.0f),
+        body(std::make_unique<Model>(bodyPath)), arm(std::make_unique<Model>(armPath)) {
+    }
+
+    // Starts without geometry; body and arm are attached once loaded.
+    explicit Robot(glm::vec3 startPos)
+        : position(startPos), rotationY(0.0f) {
     }
 
 
@@ -28,16 +37,33 @@ public:
         return glm::distance(position, target) < threshold;
     }
 
-    void draw(Shader& shader, float armAngle) {
+    void submit(RenderQueue& queue, ShaderVariants& shaders, float armAngle) {
+        if (!body || !arm)
+            return;
+        glm::mat4 bodyMat = bodyTransform();
+        bodySlot.set(bodyMat);
+        armSlot.set(armTransform(bodyMat, armAngle));
+        body->submit(queue, shaders, bodySlot.index(), glm::vec3(0.6f));
+        arm->submit(queue, shaders, armSlot.index(), glm::vec3(0.6f));
+    }
+
+    // World-space sphere holding body and arm at any arm angle.
+    void boundingSphere(glm::vec3& center, float& radius) const {
+        glm::mat4 bodyMat = bodyTransform();
+        center = glm::vec3(bodyMat * glm::vec4(body ? (body->boundsMin + body->boundsMax) * 0.5f : glm::vec3(0.0f), 1.0f));
+        float scale = glm::length(glm::vec3(bodyMat[0]));
+        radius = ((body ? body->boundsRadius : 1.0f) + (arm ? 2.0f * arm->boundsRadius : 0.0f)) * scale;
+    }
+
+    glm::mat4 bodyTransform() const {
         glm::mat4 bodyMat = glm::mat4(1.0f);
         bodyMat = glm::translate(bodyMat, position + glm::vec3(0.0f, 0.6f, 0.0f));
         bodyMat = glm::rotate(bodyMat, glm::radians(rotationY), glm::vec3(0.0f, 1.0f, 0.0f));
         bodyMat = glm::scale(bodyMat, glm::vec3(0.5f));
-        shader.setMat4("model", bodyMat);
-        glUniform1i(glGetUniformLocation(shader.ID, "useTexture"), true);
-        glUniform3f(glGetUniformLocation(shader.ID, "objectColor"), 0.6f, 0.6f, 0.6f);
-        body.Draw(shader);
+        return bodyMat;
+    }
 
+    glm::mat4 armTransform(const glm::mat4& bodyMat, float armAngle) const {
         glm::mat4 armMat = glm::mat4(1.0f);
 
         armMat = glm::translate(armMat, glm::vec3(-0.030f, -0.015f, -0.02f));
@@ -46,13 +72,7 @@ public:
 
         armMat = glm::scale(armMat, glm::vec3(1.0f));
 
-        armMat = bodyMat * armMat;
-
-
-        shader.setMat4("model", armMat);
-        glUniform1i(glGetUniformLocation(shader.ID, "useTexture"), true);
-        glUniform3f(glGetUniformLocation(shader.ID, "objectColor"), 0.6f, 0.6f, 0.6f);
-        arm.Draw(shader);
+        return bodyMat * armMat;
     }
 
 
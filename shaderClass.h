@@ -3,58 +3,264 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <iostream>
+#include <vector>
 
+#include "gl_ext.h"
+#include "hash.h"
+#include "program_cache.h"
+
+// A uniform name reduced to its hash. Declared constexpr, the hash is
+// computed by the compiler.
+struct UniformName {
+    uint64_t hash;
+    const char* text;
+
+    constexpr UniformName(const char* name) : hash(hashString(name)), text(name) {
+    }
+};
+
+// Pre-resolved location of an active uniform of type T. count is the array
+// length, 1 for plain uniforms. A default handle has location -1, which GL
+// ignores, so a uniform the compiler optimized out costs nothing.
+template <typename T>
+struct Uniform {
+    GLint location = -1;
+    GLint count = 0;
+
+    explicit operator bool() const {
+        return location >= 0;
+    }
+};
+
+// Handles of the camera uniforms most programs share, resolved once at
+// link so per-frame camera updates do no lookups.
+struct CameraUniforms {
+    Uniform<glm::mat4> view;
+    Uniform<glm::mat4> projection;
+    Uniform<glm::vec3> viewPos;
+};
+
+// A linked program. It is loaded from the ProgramCache when the cache has a
+// binary for the same sources and driver, and compiled otherwise.
 class Shader {
 public:
     unsigned int ID;
+    CameraUniforms camera;
 
-    Shader(const char* vertexCode, const char* fragmentCode) {
-        unsigned int vertex, fragment;
+    // With wait false only the compile and link are issued, so several
+    // programs can build at once (in the background where the driver has
+    // parallel shader compile); poll ready() and call finish() before the
+    // program is used.
+    Shader(const char* vertexCode, const char* fragmentCode, bool wait = true) {
+        sourceKey = hashString(fragmentCode, hashString(vertexCode));
+        ID = glCreateProgram();
+        if (ProgramCache::load(sourceKey, ID)) {
+            fromCache = true;
+        }
+        else {
+            glDeleteProgram(ID);
+            ID = glCreateProgram();
 
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vertexCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+            vertex = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(vertex, 1, &vertexCode, NULL);
+            glCompileShader(vertex);
 
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fragmentCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+            fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragment, 1, &fragmentCode, NULL);
+            glCompileShader(fragment);
 
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+            glAttachShader(ID, vertex);
+            glAttachShader(ID, fragment);
+            ProgramCache::markRetrievable(ID);
+            glLinkProgram(ID);
+        }
+        if (wait)
+            finish();
+    }
+
+    // Whether finish() would return without waiting for the driver. Without
+    // parallel shader compile there is no way to ask, so this is true.
+    bool ready() const {
+        if (finished || fromCache || !GLExt::parallelShaderCompile)
+            return true;
+        GLint done = 0;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done != 0;
+    }
 
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+    // Reports compile and link errors, stores a new binary in the cache and
+    // builds the uniform table and camera handles. Waits for the driver if
+    // it is still busy.
+    void finish() {
+        if (finished)
+            return;
+        finished = true;
+        if (!fromCache) {
+            checkCompileErrors(vertex, "VERTEX");
+            checkCompileErrors(fragment, "FRAGMENT");
+            checkCompileErrors(ID, "PROGRAM");
+            glDetachShader(ID, vertex);
+            glDetachShader(ID, fragment);
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+
+            GLint linked = 0;
+            glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+            if (linked)
+                ProgramCache::store(sourceKey, ID);
+        }
+        reflectUniforms();
+        static constexpr UniformName VIEW = "view";
+        static constexpr UniformName PROJECTION = "projection";
+        static constexpr UniformName VIEW_POS = "viewPos";
+        camera = { uniform<glm::mat4>(VIEW), uniform<glm::mat4>(PROJECTION), uniform<glm::vec3>(VIEW_POS) };
+    }
+
+    bool loadedFromCache() const {
+        return fromCache;
     }
 
     void use() const {
         glUseProgram(ID);
     }
 
+    // Looks the name up in the table built at link time; no GL call. Resolve
+    // handles once and keep them rather than calling this every frame.
+    template <typename T>
+    Uniform<T> uniform(UniformName name) const {
+        auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name.hash,
+            [](const UniformEntry& entry, uint64_t hash) { return entry.hash < hash; });
+        if (it != uniforms.end() && it->collides) {
+            while (it != uniforms.end() && it->hash == name.hash && it->name != name.text)
+                ++it;
+        }
+        if (it == uniforms.end() || it->hash != name.hash)
+            return {};
+        if (!typeMatches<T>(it->type)) {
+            std::cerr << "WARN: uniform " << name.text << " used with the wrong type" << std::endl;
+            return {};
+        }
+        return { it->location, it->count };
+    }
+
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<float> uniform, float value) const {
+        glUniform1f(uniform.location, value);
+    }
+    void set(Uniform<int> uniform, int value) const {
+        glUniform1i(uniform.location, value);
+    }
+    void set(Uniform<bool> uniform, bool value) const {
+        glUniform1i(uniform.location, (int)value);
+    }
+
+    // Whole arrays in one call, starting at element 0.
+    void set(Uniform<glm::vec3> uniform, const glm::vec3* values, GLsizei count) const {
+        glUniform3fv(uniform.location, std::min(count, uniform.count), &values[0][0]);
+    }
+    void set(Uniform<float> uniform, const float* values, GLsizei count) const {
+        glUniform1fv(uniform.location, std::min(count, uniform.count), values);
+    }
+
+    // GLSL 330 cannot give a block its binding point, so it is set here.
+    void bindBlock(const char* blockName, GLuint binding) const {
+        GLuint index = glGetUniformBlockIndex(ID, blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+
     void setMat4(const std::string& name, const glm::mat4& mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform<glm::mat4>(name.c_str()), mat);
     }
     void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        set(uniform<bool>(name.c_str()), value);
     }
     void setVec3(const std::string& name, glm::vec3 value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        set(uniform<glm::vec3>(name.c_str()), value);
     }
     void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        set(uniform<float>(name.c_str()), value);
     }
     void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        set(uniform<int>(name.c_str()), value);
     }
 
 
 private:
+    struct UniformEntry {
+        uint64_t hash;
+        GLint location;
+        GLint count;
+        GLenum type;
+        std::string name;
+        // Another name has the same hash; lookups compare names instead.
+        bool collides = false;
+    };
+
+    // Sorted by hash.
+    std::vector<UniformEntry> uniforms;
+    uint64_t sourceKey = 0;
+    unsigned int vertex = 0, fragment = 0;
+    bool fromCache = false;
+    bool finished = false;
+
+    // Every active uniform by name; arrays are listed both as "name" (the
+    // whole array) and as each "name[i]".
+    void reflectUniforms() {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> buffer(std::max(maxLength, 1));
+
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, static_cast<GLuint>(i), static_cast<GLsizei>(buffer.size()), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            // Members of uniform blocks have no location.
+            if (location < 0)
+                continue;
+
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                name.resize(name.size() - 3);
+                for (GLint element = 0; element < size; element++) {
+                    std::string elementName = name + "[" + std::to_string(element) + "]";
+                    GLint elementLocation = glGetUniformLocation(ID, elementName.c_str());
+                    uniforms.push_back({ hashString(elementName.c_str()), elementLocation, 1, type, elementName });
+                }
+            }
+            uniforms.push_back({ hashString(name.c_str()), location, size, type, name });
+        }
+        std::sort(uniforms.begin(), uniforms.end(),
+            [](const UniformEntry& a, const UniformEntry& b) { return a.hash < b.hash; });
+        // Two names with one hash would make lookups return the wrong one,
+        // so those fall back to comparing names.
+        for (size_t i = 1; i < uniforms.size(); i++) {
+            if (uniforms[i].hash != uniforms[i - 1].hash)
+                continue;
+            uniforms[i].collides = uniforms[i - 1].collides = true;
+            std::cerr << "WARN: uniforms " << uniforms[i - 1].name << " and " << uniforms[i].name
+                << " have the same name hash; looking them up by name" << std::endl;
+        }
+    }
+
+    template <typename T>
+    static bool typeMatches(GLenum type);
+
     static void checkCompileErrors(unsigned int shader, const std::string& type) {
         int success;
         char infoLog[1024];
@@ -75,4 +281,14 @@ private:
     }
 };
 
+template <> inline bool Shader::typeMatches<glm::mat4>(GLenum type) { return type == GL_FLOAT_MAT4; }
+template <> inline bool Shader::typeMatches<glm::vec2>(GLenum type) { return type == GL_FLOAT_VEC2; }
+template <> inline bool Shader::typeMatches<glm::vec3>(GLenum type) { return type == GL_FLOAT_VEC3; }
+template <> inline bool Shader::typeMatches<float>(GLenum type) { return type == GL_FLOAT; }
+template <> inline bool Shader::typeMatches<bool>(GLenum type) { return type == GL_BOOL || type == GL_INT; }
+template <> inline bool Shader::typeMatches<int>(GLenum type) {
+    return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_2D_SHADOW ||
+        type == GL_SAMPLER_BUFFER || type == GL_INT_SAMPLER_BUFFER || type == GL_UNSIGNED_INT_SAMPLER_BUFFER;
+}
+
 #endif
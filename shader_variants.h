@@ -0,0 +1,124 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "shaderClass.h"
+
+// Feature bits of a shader permutation. Each set bit is compiled in as
+// "#define <name>", so a variant carries no branch for a feature it lacks.
+enum ShaderFeature : uint32_t {
+    SHADER_NONE = 0,
+    SHADER_TEXTURED = 1u << 0, // base color from texture_diffuse1 instead of the instance color
+};
+
+// One vertex/fragment source pair compiled into a variant per feature set.
+// Sources start after the #version line, which is added here together with
+// the variant's defines. Variants are compiled the first time they are
+// asked for, or all together ahead of time with prepare(), and kept for
+// the lifetime of the object; features outside supportedFeatures are
+// dropped from the key, so sources that ignore a feature share one program
+// for it.
+class ShaderVariants {
+public:
+    static constexpr const char* VERSION = "#version 330 core\n";
+
+    // Runs once on every new variant, for block bindings, sampler units and
+    // other state the program keeps.
+    using Setup = std::function<void(const Shader&)>;
+
+    ShaderVariants(std::string vertexSource, std::string fragmentSource, uint32_t supportedFeatures, Setup setup = {})
+        : vertexSource(std::move(vertexSource)), fragmentSource(std::move(fragmentSource)),
+        supportedFeatures(supportedFeatures), setup(std::move(setup)) {
+    }
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // Starts building every listed variant without waiting for any of
+    // them, so the driver can work on all of them at once.
+    void prepare(std::initializer_list<uint32_t> featureSets) {
+        for (uint32_t features : featureSets)
+            find(features);
+    }
+
+    // Finishes the variants the driver is done with; never waits.
+    void poll() {
+        for (Variant& variant : variants) {
+            if (!variant.finished && variant.shader->ready())
+                finish(variant);
+        }
+    }
+
+    // The program for these features, waiting for it if it is still being
+    // built; the reference stays valid.
+    const Shader& get(uint32_t features) {
+        Variant& variant = find(features);
+        if (!variant.finished)
+            finish(variant);
+        return *variant.shader;
+    }
+
+    // Calls f on every finished variant.
+    template <typename F>
+    void forEach(F f) const {
+        for (const Variant& variant : variants) {
+            if (variant.finished)
+                f(*variant.shader);
+        }
+    }
+
+    size_t compiledCount() const {
+        return variants.size();
+    }
+
+private:
+    struct Variant {
+        uint32_t features;
+        std::unique_ptr<Shader> shader;
+        bool finished = false;
+    };
+
+    static constexpr std::pair<uint32_t, const char*> FEATURE_NAMES[] = {
+        { SHADER_TEXTURED, "TEXTURED" },
+    };
+
+    std::string vertexSource;
+    std::string fragmentSource;
+    uint32_t supportedFeatures;
+    Setup setup;
+    std::vector<Variant> variants;
+
+    Variant& find(uint32_t features) {
+        features &= supportedFeatures;
+        for (Variant& variant : variants) {
+            if (variant.features == features)
+                return variant;
+        }
+
+        std::string defines = VERSION;
+        for (const auto& [bit, name] : FEATURE_NAMES) {
+            if (features & bit)
+                defines += std::string("#define ") + name + "\n";
+        }
+        std::string vertex = defines + vertexSource;
+        std::string fragment = defines + fragmentSource;
+        variants.push_back({ features, std::make_unique<Shader>(vertex.c_str(), fragment.c_str(), false) });
+        return variants.back();
+    }
+
+    void finish(Variant& variant) {
+        variant.shader->finish();
+        variant.finished = true;
+        if (setup)
+            setup(*variant.shader);
+    }
+};
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstring>
+
+#include "frustum_culler.h"
+#include "shaderClass.h"
+
+// GLSL declarations for sampling the ShadowAtlas, to insert after #version
+// in fragment shaders. shadowFactor() is 1 when the view index is negative
+// or the point lies outside that view, otherwise the 2x2 filtered
+// fraction of the point that is lit.
+inline constexpr const char* SHADOW_ATLAS_GLSL = R"(
+#define MAX_SHADOW_VIEWS 6
+layout(std140) uniform ShadowBlock {
+    mat4 shadowMatrices[MAX_SHADOW_VIEWS];
+    vec4 shadowTiles[MAX_SHADOW_VIEWS];
+};
+uniform sampler2DShadow shadowAtlas;
+
+float shadowFactor(int view, vec3 worldPos, vec3 normal)
+{
+    if (view < 0)
+        return 1.0;
+    vec4 p = shadowMatrices[view] * vec4(worldPos + normal * 0.02, 1.0);
+    if (p.w <= 0.0)
+        return 1.0;
+    p.xyz /= p.w;
+    vec4 tile = shadowTiles[view];
+    if (any(lessThan(p.xy, tile.xy)) || any(greaterThan(p.xy, tile.zw)) || p.z >= 1.0)
+        return 1.0;
+    return texture(shadowAtlas, p.xyz);
+}
+)";
+
+// Shadow maps for up to MAX_VIEWS perspective light views, packed as tiles
+// of one depth atlas. Static casters are rendered into a cached atlas only
+// when a view moves or invalidate() touches it; every frame the final
+// atlas gets a copy of the cached tile plus the dynamic casters, and only
+// for tiles the dynamic casters are in (or just left). Every other tile is
+// left as it was, so a frame where nothing changed renders no shadow pass.
+class ShadowAtlas {
+public:
+    static constexpr int MAX_VIEWS = 6;
+    static constexpr int COLUMNS = 3;
+    static constexpr int ROWS = 2;
+    static constexpr int TILE_SIZE = 1024;
+    static constexpr GLuint UNIT = 5;
+    static constexpr GLuint BINDING = 1;
+
+    struct Stats {
+        int staticRendered = 0;
+        int staticSkipped = 0;
+        int dynamicRendered = 0;
+        int tilesCopied = 0;
+    };
+
+    ShadowAtlas() {
+        for (int i = 0; i < 2; i++) {
+            glGenTextures(1, &textures[i]);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, COLUMNS * TILE_SIZE, ROWS * TILE_SIZE, 0,
+                GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+            glGenFramebuffers(1, &framebuffers[i]);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[i], 0);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        std::memset(&block, 0, sizeof(block));
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, UBO);
+    }
+
+    ~ShadowAtlas() {
+        release();
+    }
+
+    ShadowAtlas(const ShadowAtlas&) = delete;
+    ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+    static void attach(const Shader& shader) {
+        static constexpr UniformName SHADOW_ATLAS = "shadowAtlas";
+        shader.bindBlock("ShadowBlock", BINDING);
+        shader.use();
+        shader.set(shader.uniform<int>(SHADOW_ATLAS), static_cast<int>(UNIT));
+    }
+
+    // Places view i at position looking along direction; its cached map is
+    // redrawn only if this differs from the last call.
+    void setView(int i, const glm::vec3& position, const glm::vec3& direction, float fovDegrees, float range) {
+        View& view = views[i];
+        if (view.used && view.position == position && view.direction == direction && view.fovDegrees == fovDegrees &&
+            view.range == range)
+            return;
+        view.used = true;
+        view.position = position;
+        view.direction = direction;
+        view.fovDegrees = fovDegrees;
+        view.range = range;
+        view.stale = true;
+
+        glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        view.viewMatrix = glm::lookAt(position, position + direction, up);
+        view.projection = glm::perspective(glm::radians(fovDegrees), 1.0f, 0.05f, range);
+        glm::mat4 viewProjection = view.projection * view.viewMatrix;
+        view.frustum = Frustum::fromMatrix(viewProjection);
+
+        // Light clip space to the tile's texture coordinates and [0, 1] depth.
+        glm::vec2 tileMin(float(i % COLUMNS) / COLUMNS, float(i / COLUMNS) / ROWS);
+        glm::vec2 tileSize(1.0f / COLUMNS, 1.0f / ROWS);
+        glm::mat4 toTile = glm::translate(glm::mat4(1.0f), glm::vec3(tileMin + tileSize * 0.5f, 0.5f)) *
+            glm::scale(glm::mat4(1.0f), glm::vec3(tileSize * 0.5f, 0.5f));
+        block.matrices[i] = toTile * viewProjection;
+        block.tiles[i] = glm::vec4(tileMin, tileMin + tileSize);
+        blockDirty = true;
+    }
+
+    // Redraws the cached map of every view that can see the sphere, for
+    // static casters that appeared, changed or went away.
+    void invalidate(const glm::vec3& center, float radius) {
+        for (View& view : views) {
+            if (view.used && intersects(view.frustum, center, radius))
+                view.stale = true;
+        }
+    }
+
+    // Brings the atlas up to date. drawStatic and drawDynamic are called
+    // with a view and projection, with the target bound and the depth
+    // shader state left to them; the dynamic casters are expected to lie
+    // inside the sphere (dynamicCenter, dynamicRadius), and a radius of 0
+    // means there are none.
+    template <typename DrawStatic, typename DrawDynamic>
+    void render(DrawStatic drawStatic, DrawDynamic drawDynamic, const glm::vec3& dynamicCenter, float dynamicRadius) {
+        stats = Stats();
+        if (blockDirty) {
+            glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            blockDirty = false;
+        }
+
+        GLint savedViewport[4];
+        GLint savedFramebuffer = 0;
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &savedFramebuffer);
+        glEnable(GL_SCISSOR_TEST);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+
+        for (int i = 0; i < MAX_VIEWS; i++) {
+            View& view = views[i];
+            if (!view.used)
+                continue;
+            bool dynamicInside = dynamicRadius > 0.0f && intersects(view.frustum, dynamicCenter, dynamicRadius);
+            bool refresh = view.stale || dynamicInside || view.hadDynamic;
+            GLint x = (i % COLUMNS) * TILE_SIZE, y = (i / COLUMNS) * TILE_SIZE;
+            // Clears and the blit are clipped to the tile as well.
+            glScissor(x, y, TILE_SIZE, TILE_SIZE);
+
+            if (view.stale) {
+                bindTile(framebuffers[CACHED], x, y);
+                drawStatic(view.viewMatrix, view.projection);
+                view.stale = false;
+                stats.staticRendered++;
+            }
+            else {
+                stats.staticSkipped++;
+            }
+
+            if (refresh) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[CACHED]);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[FINAL]);
+                glBlitFramebuffer(x, y, x + TILE_SIZE, y + TILE_SIZE, x, y, x + TILE_SIZE, y + TILE_SIZE,
+                    GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+                stats.tilesCopied++;
+            }
+            if (dynamicInside) {
+                bindTile(framebuffers[FINAL], x, y, false);
+                drawDynamic(view.viewMatrix, view.projection);
+                stats.dynamicRendered++;
+            }
+            view.hadDynamic = dynamicInside;
+        }
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+
+        glActiveTexture(GL_TEXTURE0 + UNIT);
+        glBindTexture(GL_TEXTURE_2D, textures[FINAL]);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    const Stats& lastStats() const {
+        return stats;
+    }
+
+    // Deletes the atlas textures and block; call before the GL context
+    // goes away.
+    void release() {
+        if (UBO == 0)
+            return;
+        glDeleteFramebuffers(2, framebuffers);
+        glDeleteTextures(2, textures);
+        glDeleteBuffers(1, &UBO);
+        framebuffers[CACHED] = framebuffers[FINAL] = 0;
+        textures[CACHED] = textures[FINAL] = 0;
+        UBO = 0;
+    }
+
+private:
+    static constexpr int CACHED = 0;
+    static constexpr int FINAL = 1;
+
+    struct View {
+        bool used = false;
+        bool stale = false;
+        bool hadDynamic = false;
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 direction = glm::vec3(0.0f);
+        float fovDegrees = 0.0f;
+        float range = 0.0f;
+        glm::mat4 viewMatrix = glm::mat4(1.0f);
+        glm::mat4 projection = glm::mat4(1.0f);
+        Frustum frustum;
+    };
+
+    // Mirror of ShadowBlock in SHADOW_ATLAS_GLSL; mat4 and vec4 arrays have
+    // the same layout under std140.
+    struct Block {
+        glm::mat4 matrices[MAX_VIEWS];
+        glm::vec4 tiles[MAX_VIEWS];
+    };
+
+    View views[MAX_VIEWS];
+    Block block;
+    bool blockDirty = true;
+    unsigned int textures[2] = {};
+    unsigned int framebuffers[2] = {};
+    unsigned int UBO = 0;
+    Stats stats;
+
+    static void bindTile(unsigned int framebuffer, GLint x, GLint y, bool clear = true) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(x, y, TILE_SIZE, TILE_SIZE);
+        if (clear)
+            glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    static bool intersects(const Frustum& frustum, const glm::vec3& center, float radius) {
+        for (const glm::vec4& plane : frustum.planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * glm::length(glm::vec3(plane)))
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
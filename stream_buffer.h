@@ -0,0 +1,188 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "gl_ext.h"
+
+// A buffer for data written once per frame and drawn the same frame, split
+// into FRAMES regions used in turn. Each region is fenced when its frame
+// ends and is written again only once the GPU has passed that fence, so
+// writing never waits for draws still in flight.
+//
+// With buffer storage the whole buffer is mapped once, persistently and
+// coherently, and allocate() just hands out pointers into it. Without it
+// the region is mapped unsynchronized while being written and must be
+// unmapped with commit() before drawing from it; if the GPU is still on a
+// region when it comes round again, the buffer is orphaned instead of
+// waited for. The buffer name never changes, so VAOs can point at it once.
+class StreamBuffer {
+public:
+    static constexpr int FRAMES = 3;
+
+    struct Allocation {
+        void* data = nullptr;
+        size_t offset = 0;    // from the start of buffer()
+
+        explicit operator bool() const {
+            return data != nullptr;
+        }
+    };
+
+    struct Stats {
+        int waits = 0;        // frames that had to wait for a fence
+        int orphans = 0;      // frames that orphaned the buffer instead
+    };
+
+    StreamBuffer(GLenum target, size_t frameBytes)
+        : target(target), frameBytes(frameBytes), persistent(GLExt::bufferStorage) {
+        glGenBuffers(1, &VBO);
+        glBindBuffer(target, VBO);
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLExt::bufferStorageCreate(target, FRAMES * frameBytes, nullptr, flags);
+            persistentData = static_cast<uint8_t*>(glMapBufferRange(target, 0, FRAMES * frameBytes, flags));
+        }
+        else {
+            glBufferData(target, FRAMES * frameBytes, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(target, 0);
+    }
+
+    ~StreamBuffer() {
+        release();
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // bytes from the current frame's region at the given alignment, or an
+    // empty Allocation if the region is full. The first call of a frame
+    // claims its region.
+    Allocation allocate(size_t bytes, size_t alignment = 16) {
+        if (!frameOpen)
+            beginFrame();
+        size_t offset = (used + alignment - 1) / alignment * alignment;
+        if (offset + bytes > frameBytes)
+            return {};
+        used = offset + bytes;
+
+        size_t absolute = region * frameBytes + offset;
+        if (persistent)
+            return { persistentData + absolute, absolute };
+        if (!mapped) {
+            // Only the part not handed out yet; earlier allocations may
+            // already have been committed and drawn.
+            mappedOffset = absolute;
+            glBindBuffer(target, VBO);
+            mapped = static_cast<uint8_t*>(glMapBufferRange(target, absolute, (region + 1) * frameBytes - absolute,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+            glBindBuffer(target, 0);
+            if (!mapped)
+                return {};
+        }
+        return { mapped + (absolute - mappedOffset), absolute };
+    }
+
+    // Makes what was written visible to draws; call before drawing.
+    void commit() {
+        if (!mapped)
+            return;
+        glBindBuffer(target, VBO);
+        glUnmapBuffer(target);
+        glBindBuffer(target, 0);
+        mapped = nullptr;
+    }
+
+    // Fences the current region after its last draw and moves to the next.
+    void endFrame() {
+        if (!frameOpen)
+            return;
+        commit();
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % FRAMES;
+        frameOpen = false;
+    }
+
+    unsigned int buffer() const {
+        return VBO;
+    }
+
+    bool isPersistent() const {
+        return persistent;
+    }
+
+    // Totals since creation.
+    const Stats& stats() const {
+        return counters;
+    }
+
+    // Unmaps and deletes the buffer and its fences; call before the GL
+    // context goes away. Nothing may be allocated afterwards.
+    void release() {
+        if (VBO == 0)
+            return;
+        for (GLsync& fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        glBindBuffer(target, VBO);
+        if (persistentData || mapped)
+            glUnmapBuffer(target);
+        glBindBuffer(target, 0);
+        glDeleteBuffers(1, &VBO);
+        VBO = 0;
+        persistentData = mapped = nullptr;
+    }
+
+private:
+    GLenum target;
+    size_t frameBytes;
+    bool persistent;
+    unsigned int VBO = 0;
+    uint8_t* persistentData = nullptr;
+    uint8_t* mapped = nullptr;
+    size_t mappedOffset = 0;
+    GLsync fences[FRAMES] = {};
+    int region = 0;
+    size_t used = 0;
+    bool frameOpen = false;
+    Stats counters;
+
+    void beginFrame() {
+        frameOpen = true;
+        used = 0;
+        GLsync& fence = fences[region];
+        if (!fence)
+            return;
+
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED && !persistent) {
+            // New storage is free to write now; the GPU keeps the old one
+            // until it is done with it, so no region needs its fence.
+            glBindBuffer(target, VBO);
+            glBufferData(target, FRAMES * frameBytes, nullptr, GL_STREAM_DRAW);
+            glBindBuffer(target, 0);
+            for (GLsync& other : fences) {
+                if (other) {
+                    glDeleteSync(other);
+                    other = nullptr;
+                }
+            }
+            counters.orphans++;
+            return;
+        }
+        if (status == GL_TIMEOUT_EXPIRED) {
+            counters.waits++;
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+            }
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+};
+
+#endif
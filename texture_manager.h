@@ -0,0 +1,308 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "stb_image.h"
+#include "dds.h"
+#include "gl_ext.h"
+#include "hash.h"
+#include "mapped_file.h"
+
+struct StbiDeleter {
+    void operator()(unsigned char* data) const { stbi_image_free(data); }
+};
+
+// Texture file read for GL upload: either raw pixels from stb_image or,
+// when a converted .dds sits next to the source, its block-compressed mip
+// chain. contentHash covers the bytes that were actually read.
+struct ImageData {
+    std::string path;
+    uint64_t contentHash = 0;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    std::unique_ptr<unsigned char, StbiDeleter> pixels;
+    dds::Image compressed;
+
+    bool decoded() const {
+        return pixels != nullptr || !compressed.levels.empty();
+    }
+};
+
+class TextureHandle;
+
+// Process-wide owner of every GL texture. Textures are keyed by the hash of
+// their file contents, so byte-identical images under different names share
+// one GL object. Meshes hold ref-counted TextureHandles and the GL texture is
+// deleted when the last handle goes away. Only decodeImage() and
+// isResident() may be called off the main thread.
+class TextureManager {
+public:
+    struct Info {
+        std::string path;
+        unsigned int id;
+        int width;
+        int height;
+        const char* format;
+        size_t bytes;
+        int refs;
+    };
+
+    static TextureManager& instance() {
+        static TextureManager manager;
+        return manager;
+    }
+
+    // Reads and decodes the image on the calling thread. Images whose content
+    // is already resident are only hashed, not decoded.
+    static void decodeImage(ImageData& image) {
+        if (GLExt::textureCompressionS3TC && loadCompressed(image))
+            return;
+
+        MappedFile file(image.path);
+        if (!file.isOpen()) {
+            std::cerr << "Texture failed to load at path: " << image.path << std::endl;
+            return;
+        }
+        image.contentHash = hashBytes(file.data(), file.size());
+        if (instance().isResident(image.contentHash))
+            return;
+
+        image.pixels.reset(stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()),
+            static_cast<int>(file.size()), &image.width, &image.height, &image.components, 0));
+        if (!image.pixels)
+            std::cerr << "Texture failed to load at path: " << image.path << std::endl;
+    }
+
+    bool isResident(uint64_t contentHash) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return byHash.count(contentHash) != 0;
+    }
+
+    TextureHandle acquire(ImageData& image);
+
+    std::vector<Info> stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Info> result;
+        for (const Entry& entry : entries) {
+            if (entry.refs > 0)
+                result.push_back({ entry.path, entry.id, entry.width, entry.height, entry.format, entry.bytes, entry.refs });
+        }
+        return result;
+    }
+
+    size_t totalBytes() {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t total = 0;
+        for (const Entry& entry : entries)
+            total += entry.refs > 0 ? entry.bytes : 0;
+        return total;
+    }
+
+private:
+    friend class TextureHandle;
+
+    struct Entry {
+        std::string path;
+        uint64_t hash = 0;
+        unsigned int id = 0;
+        int width = 0;
+        int height = 0;
+        const char* format = "";
+        size_t bytes = 0;
+        int refs = 0;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+    std::vector<int> freeSlots;
+    std::unordered_map<uint64_t, int> byHash;
+
+    TextureManager() = default;
+
+    void addRef(int slot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries[slot].refs++;
+    }
+
+    void release(int slot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries[slot];
+        if (--entry.refs > 0)
+            return;
+        glDeleteTextures(1, &entry.id);
+        byHash.erase(entry.hash);
+        entry = Entry();
+        freeSlots.push_back(slot);
+    }
+
+    unsigned int idOf(int slot) {
+        return entries[slot].id;
+    }
+
+    size_t bytesOf(int slot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries[slot].bytes;
+    }
+
+    // Prefers "<name>.dds" produced by tools/texconv when it is at least as
+    // new as the source image.
+    static bool loadCompressed(ImageData& image) {
+        std::filesystem::path ddsPath = image.path;
+        ddsPath.replace_extension(".dds");
+
+        std::error_code ec;
+        if (!std::filesystem::exists(ddsPath, ec))
+            return false;
+        if (std::filesystem::last_write_time(ddsPath, ec) < std::filesystem::last_write_time(image.path, ec)) {
+            std::cerr << "WARN: ignoring stale " << ddsPath.string() << ", run texconv again" << std::endl;
+            return false;
+        }
+
+        MappedFile file(ddsPath.string());
+        if (!file.isOpen() || !dds::parse(file.data(), file.size(), image.compressed)) {
+            std::cerr << "WARN: unsupported DDS " << ddsPath.string() << std::endl;
+            image.compressed = dds::Image();
+            return false;
+        }
+
+        image.contentHash = hashBytes(file.data(), file.size());
+        image.width = static_cast<int>(image.compressed.levels[0].width);
+        image.height = static_cast<int>(image.compressed.levels[0].height);
+        return true;
+    }
+
+    static void upload(const ImageData& image, Entry& entry) {
+        glGenTextures(1, &entry.id);
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+
+        if (!image.compressed.levels.empty()) {
+            bool bc1 = image.compressed.fourCC == dds::FOURCC_DXT1;
+            GLenum format = bc1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+            const auto& levels = image.compressed.levels;
+            for (size_t i = 0; i < levels.size(); i++) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), format, levels[i].width, levels[i].height, 0,
+                    static_cast<GLsizei>(levels[i].size), image.compressed.data.data() + levels[i].offset);
+                entry.bytes += levels[i].size;
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size() - 1));
+            entry.format = bc1 ? "BC1" : "BC3";
+        }
+        else if (image.pixels) {
+            GLenum format = (image.components == 1) ? GL_RED :
+                (image.components == 3) ? GL_RGB : GL_RGBA;
+
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+            // Drivers pad RGB8 to four bytes per texel; mips add a third.
+            size_t texel = (image.components == 1) ? 1 : 4;
+            entry.bytes = static_cast<size_t>(image.width) * image.height * texel * 4 / 3;
+            entry.format = (image.components == 1) ? "R8" : (image.components == 3) ? "RGB8" : "RGBA8";
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        entry.width = image.width;
+        entry.height = image.height;
+    }
+};
+
+class TextureHandle {
+public:
+    TextureHandle() = default;
+
+    TextureHandle(const TextureHandle& other) : slot(other.slot) {
+        if (slot >= 0)
+            TextureManager::instance().addRef(slot);
+    }
+
+    TextureHandle(TextureHandle&& other) noexcept : slot(other.slot) {
+        other.slot = -1;
+    }
+
+    TextureHandle& operator=(TextureHandle other) noexcept {
+        std::swap(slot, other.slot);
+        return *this;
+    }
+
+    ~TextureHandle() {
+        if (slot >= 0)
+            TextureManager::instance().release(slot);
+    }
+
+    unsigned int id() const {
+        return slot >= 0 ? TextureManager::instance().idOf(slot) : 0;
+    }
+
+    // GPU memory of the texture, shared with every other holder.
+    size_t bytes() const {
+        return slot >= 0 ? TextureManager::instance().bytesOf(slot) : 0;
+    }
+
+    explicit operator bool() const {
+        return slot >= 0;
+    }
+
+private:
+    friend class TextureManager;
+    int slot = -1;
+
+    explicit TextureHandle(int adoptedSlot) : slot(adoptedSlot) {
+    }
+};
+
+// Returns a handle to the texture with this image's content, uploading it
+// if nobody holds it yet. Must run on the GL thread.
+inline TextureHandle TextureManager::acquire(ImageData& image) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = byHash.find(image.contentHash);
+        if (image.contentHash != 0 && it != byHash.end()) {
+            entries[it->second].refs++;
+            return TextureHandle(it->second);
+        }
+    }
+
+    // The worker skipped decoding because the content was resident, but the
+    // last user let go before this upload; decode it here instead.
+    if (!image.decoded())
+        decodeImage(image);
+    if (!image.decoded())
+        return TextureHandle();
+
+    Entry entry;
+    entry.path = image.path;
+    entry.hash = image.contentHash;
+    entry.refs = 1;
+    upload(image, entry);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        entries[slot] = entry;
+    }
+    else {
+        slot = static_cast<int>(entries.size());
+        entries.push_back(entry);
+    }
+    byHash[entry.hash] = slot;
+    return TextureHandle(slot);
+}
+
+#endif
@@ -0,0 +1,181 @@
+// Benchmark for ObjParser against tinyobj::LoadObj. Every input is loaded
+// with both (best of three runs each), the results are compared and the
+// speedup is printed. A synthetic grid OBJ with --faces triangles (1M by
+// default) is always added to the inputs and deleted afterwards.
+//
+//   objbench [--faces N] [--threads N] [file.obj | directory]...
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../Libraries/lib/tiny_obj_loader.h"
+#include "../obj_parser.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct LoadResult {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    bool ok = false;
+};
+
+static double bestOfThree(const std::function<void()>& run) {
+    double best = 1e30;
+    for (int i = 0; i < 3; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+static bool closeEnough(const std::vector<float>& a, const std::vector<float>& b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::fabs(a[i] - b[i]) > 1e-6f * std::max(1.0f, std::fabs(a[i])))
+            return false;
+    }
+    return true;
+}
+
+static std::string compare(const LoadResult& reference, const LoadResult& fast) {
+    if (!closeEnough(reference.attrib.vertices, fast.attrib.vertices)) return "vertices differ";
+    if (!closeEnough(reference.attrib.normals, fast.attrib.normals)) return "normals differ";
+    if (!closeEnough(reference.attrib.texcoords, fast.attrib.texcoords)) return "texcoords differ";
+    if (reference.shapes.size() != fast.shapes.size()) return "shape count differs";
+    if (reference.materials.size() != fast.materials.size()) return "material count differs";
+
+    for (size_t s = 0; s < reference.shapes.size(); s++) {
+        const tinyobj::mesh_t& a = reference.shapes[s].mesh;
+        const tinyobj::mesh_t& b = fast.shapes[s].mesh;
+        if (reference.shapes[s].name != fast.shapes[s].name) return "shape names differ";
+        if (a.indices.size() != b.indices.size()) return "index count differs in " + reference.shapes[s].name;
+        for (size_t i = 0; i < a.indices.size(); i++) {
+            if (a.indices[i].vertex_index != b.indices[i].vertex_index ||
+                a.indices[i].normal_index != b.indices[i].normal_index ||
+                a.indices[i].texcoord_index != b.indices[i].texcoord_index)
+                return "indices differ in " + reference.shapes[s].name;
+        }
+        if (a.material_ids != b.material_ids) return "material ids differ in " + reference.shapes[s].name;
+        if (a.smoothing_group_ids != b.smoothing_group_ids) return "smoothing groups differ in " + reference.shapes[s].name;
+    }
+    return "";
+}
+
+static std::string writeSyntheticObj(size_t faces) {
+    size_t cells = static_cast<size_t>(std::ceil(std::sqrt(faces / 2.0)));
+    std::string path = (std::filesystem::temp_directory_path() / "objbench_synthetic.obj").string();
+    std::ofstream out(path, std::ios::binary);
+
+    std::string buffer;
+    char line[128];
+    auto flush = [&]() {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    buffer += "# synthetic grid\no grid\n";
+    for (size_t y = 0; y <= cells; y++) {
+        for (size_t x = 0; x <= cells; x++) {
+            float fx = static_cast<float>(x) / cells, fy = static_cast<float>(y) / cells;
+            float height = 0.05f * std::sin(fx * 25.0f) * std::cos(fy * 17.0f);
+            std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn 0.000000 1.000000 0.000000\n",
+                fx * 2.0f - 1.0f, height, fy * 2.0f - 1.0f, fx, fy);
+            buffer += line;
+        }
+        if (buffer.size() > (1 << 20))
+            flush();
+    }
+
+    size_t written = 0;
+    for (size_t y = 0; y < cells && written < faces; y++) {
+        for (size_t x = 0; x < cells && written < faces; x++) {
+            size_t a = y * (cells + 1) + x + 1, b = a + 1, c = a + cells + 1, d = c + 1;
+            if (written * 2 == faces)
+                buffer += "g second_half\n";
+            std::snprintf(line, sizeof(line), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, c, c, c, b, b, b);
+            buffer += line;
+            if (++written < faces) {
+                std::snprintf(line, sizeof(line), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", b, b, b, c, c, c, d, d, d);
+                buffer += line;
+                written++;
+            }
+        }
+        if (buffer.size() > (1 << 20))
+            flush();
+    }
+    flush();
+    return path;
+}
+
+int main(int argc, char** argv) {
+    size_t faces = 1000000;
+    unsigned int threads = 0;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--faces" && i + 1 < argc)
+            faces = std::stoul(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+        else if (std::filesystem::is_directory(arg)) {
+            for (const auto& entry : std::filesystem::directory_iterator(arg)) {
+                if (entry.path().extension() == ".obj")
+                    inputs.push_back(entry.path().string());
+            }
+        }
+        else
+            inputs.push_back(arg);
+    }
+
+    std::string synthetic = writeSyntheticObj(faces);
+    inputs.push_back(synthetic);
+
+    double totalReference = 0.0, totalFast = 0.0;
+    int failures = 0;
+    for (const std::string& path : inputs) {
+        std::string directory = std::filesystem::path(path).parent_path().string();
+        LoadResult reference, fast;
+        std::string warn, err;
+
+        double referenceMs = bestOfThree([&] {
+            reference = LoadResult();
+            warn.clear();
+            err.clear();
+            reference.ok = tinyobj::LoadObj(&reference.attrib, &reference.shapes, &reference.materials,
+                &warn, &err, path.c_str(), directory.c_str());
+        });
+        double fastMs = bestOfThree([&] {
+            fast = LoadResult();
+            warn.clear();
+            err.clear();
+            fast.ok = ObjParser::load(&fast.attrib, &fast.shapes, &fast.materials,
+                &warn, &err, path.c_str(), directory.c_str(), threads);
+        });
+
+        std::string mismatch = (!reference.ok || !fast.ok) ? "load failed: " + err : compare(reference, fast);
+        if (!mismatch.empty())
+            failures++;
+        totalReference += referenceMs;
+        totalFast += fastMs;
+
+        std::printf("%-40s tinyobj %8.1f ms   ObjParser %7.1f ms   %5.1fx  %s\n",
+            std::filesystem::path(path).filename().string().c_str(), referenceMs, fastMs,
+            referenceMs / fastMs, mismatch.empty() ? "ok" : mismatch.c_str());
+    }
+    std::printf("%-40s tinyobj %8.1f ms   ObjParser %7.1f ms   %5.1fx\n", "total", totalReference, totalFast,
+        totalReference / totalFast);
+
+    std::error_code ec;
+    std::filesystem::remove(synthetic, ec);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+// Offline texture converter: decodes PNG/JPG with stb_image, builds the full
+// mip chain and writes it block-compressed into a DDS next to the source.
+// Opaque images become BC1 (DXT1, 4 bpp), images with any translucent pixel
+// BC3 (DXT5, 8 bpp). Model::decodeImage picks the .dds up automatically.
+//
+//   texconv <image> [output.dds]
+//   texconv --dir <directory>      converts every stale .png/.jpg in it
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+#include "../dds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct RgbaImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+
+    const uint8_t* at(int x, int y) const {
+        x = std::min(x, width - 1);
+        y = std::min(y, height - 1);
+        return &pixels[(static_cast<size_t>(y) * width + x) * 4];
+    }
+};
+
+static RgbaImage downsample(const RgbaImage& src) {
+    RgbaImage dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+    for (int y = 0; y < dst.height; y++) {
+        for (int x = 0; x < dst.width; x++) {
+            const uint8_t* a = src.at(2 * x, 2 * y);
+            const uint8_t* b = src.at(2 * x + 1, 2 * y);
+            const uint8_t* c = src.at(2 * x, 2 * y + 1);
+            const uint8_t* d = src.at(2 * x + 1, 2 * y + 1);
+            uint8_t* out = &dst.pixels[(static_cast<size_t>(y) * dst.width + x) * 4];
+            for (int k = 0; k < 4; k++)
+                out[k] = static_cast<uint8_t>((a[k] + b[k] + c[k] + d[k] + 2) / 4);
+        }
+    }
+    return dst;
+}
+
+static uint16_t pack565(const float c[3]) {
+    int r = static_cast<int>(std::lround(std::clamp(c[0], 0.0f, 255.0f) * 31.0f / 255.0f));
+    int g = static_cast<int>(std::lround(std::clamp(c[1], 0.0f, 255.0f) * 63.0f / 255.0f));
+    int b = static_cast<int>(std::lround(std::clamp(c[2], 0.0f, 255.0f) * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(uint16_t v, float out[3]) {
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    out[0] = static_cast<float>((r << 3) | (r >> 2));
+    out[1] = static_cast<float>((g << 2) | (g >> 4));
+    out[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// BC1 colour block: endpoints from the extent of the block along its
+// principal axis, always in 4-colour mode (colour0 > colour1).
+static void encodeColorBlock(const uint8_t block[16][4], uint8_t out[8]) {
+    float mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+        for (int k = 0; k < 3; k++)
+            mean[k] += block[i][k] / 16.0f;
+
+    float cov[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    float axis[3] = { 1, 1, 1 };
+    for (int iter = 0; iter < 8; iter++) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float len = std::max({ std::fabs(x), std::fabs(y), std::fabs(z) });
+        if (len < 1e-6f)
+            break;
+        axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+    }
+    float axisLen2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+    float minT = 0, maxT = 0;
+    for (int i = 0; i < 16; i++) {
+        float t = ((block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] +
+            (block[i][2] - mean[2]) * axis[2]) / axisLen2;
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+
+    float hi[3], lo[3];
+    for (int k = 0; k < 3; k++) {
+        hi[k] = mean[k] + axis[k] * maxT;
+        lo[k] = mean[k] + axis[k] * minT;
+    }
+
+    uint16_t c0 = pack565(hi), c1 = pack565(lo);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        float palette[4][3];
+        unpack565(c0, palette[0]);
+        unpack565(c1, palette[1]);
+        for (int k = 0; k < 3; k++) {
+            palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3.0f;
+            palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3.0f;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            float bestDist = 1e30f;
+            for (int p = 0; p < 4; p++) {
+                float dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                float dist = dr * dr + dg * dg + db * db;
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= static_cast<uint32_t>(best) << (2 * i);
+        }
+    }
+
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    for (int k = 0; k < 4; k++)
+        out[4 + k] = (indices >> (8 * k)) & 0xFF;
+}
+
+// BC3 alpha block in 8-value mode (alpha0 > alpha1).
+static void encodeAlphaBlock(const uint8_t block[16][4], uint8_t out[8]) {
+    uint8_t a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, block[i][3]);
+        a1 = std::min(a1, block[i][3]);
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        float palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for (int p = 2; p < 8; p++)
+            palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7.0f;
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            float bestDist = 1e30f;
+            for (int p = 0; p < 8; p++) {
+                float dist = std::fabs(block[i][3] - palette[p]);
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= static_cast<uint64_t>(best) << (3 * i);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (int k = 0; k < 6; k++)
+        out[2 + k] = (indices >> (8 * k)) & 0xFF;
+}
+
+static void compressLevel(const RgbaImage& image, uint32_t fourCC, std::vector<char>& out) {
+    int blocksX = (image.width + 3) / 4;
+    int blocksY = (image.height + 3) / 4;
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            uint8_t block[16][4];
+            for (int i = 0; i < 16; i++) {
+                const uint8_t* p = image.at(bx * 4 + i % 4, by * 4 + i / 4);
+                std::copy(p, p + 4, block[i]);
+            }
+
+            uint8_t encoded[16];
+            if (fourCC == dds::FOURCC_DXT5) {
+                encodeAlphaBlock(block, encoded);
+                encodeColorBlock(block, encoded + 8);
+            }
+            else {
+                encodeColorBlock(block, encoded);
+            }
+            out.insert(out.end(), encoded, encoded + dds::blockBytes(fourCC));
+        }
+    }
+}
+
+static bool convert(const std::string& input, const std::string& output) {
+    RgbaImage image;
+    int components = 0;
+    unsigned char* data = stbi_load(input.c_str(), &image.width, &image.height, &components, 4);
+    if (!data) {
+        std::cerr << "Cannot read " << input << ": " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+    image.pixels.assign(data, data + static_cast<size_t>(image.width) * image.height * 4);
+    stbi_image_free(data);
+
+    bool translucent = false;
+    for (size_t i = 3; i < image.pixels.size() && !translucent; i += 4)
+        translucent = image.pixels[i] != 255;
+
+    dds::Image result;
+    result.fourCC = translucent ? dds::FOURCC_DXT5 : dds::FOURCC_DXT1;
+    for (;;) {
+        size_t offset = result.data.size();
+        compressLevel(image, result.fourCC, result.data);
+        result.levels.push_back({ static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height),
+            offset, result.data.size() - offset });
+        if (image.width == 1 && image.height == 1)
+            break;
+        image = downsample(image);
+    }
+
+    if (!dds::write(output, result)) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return false;
+    }
+
+    size_t rawBytes = static_cast<size_t>(result.levels[0].width) * result.levels[0].height * 4 * 4 / 3;
+    std::cout << input << " -> " << output << " (" << (translucent ? "BC3" : "BC1") << ", "
+        << result.levels.size() << " mips, " << result.data.size() / 1024 << " KB vs "
+        << rawBytes / 1024 << " KB uncompressed)" << std::endl;
+    return true;
+}
+
+static std::string ddsPathFor(const std::filesystem::path& image) {
+    std::filesystem::path out = image;
+    out.replace_extension(".dds");
+    return out.string();
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::string(argv[1]) == "--dir") {
+        namespace fs = std::filesystem;
+        int failures = 0;
+        for (const auto& entry : fs::directory_iterator(argv[2])) {
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (ext != ".png" && ext != ".jpg" && ext != ".jpeg")
+                continue;
+
+            std::string output = ddsPathFor(entry.path());
+            std::error_code ec;
+            if (fs::exists(output, ec) && fs::last_write_time(output, ec) >= fs::last_write_time(entry.path(), ec))
+                continue;
+            if (!convert(entry.path().string(), output))
+                failures++;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    if (argc == 2 || argc == 3) {
+        std::string output = argc == 3 ? argv[2] : ddsPathFor(argv[1]);
+        return convert(argv[1], output) ? 0 : 1;
+    }
+
+    std::cerr << "usage: texconv <image> [output.dds]\n       texconv --dir <directory>" << std::endl;
+    return 2;
+}
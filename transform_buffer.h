@@ -0,0 +1,232 @@
+#ifndef TRANSFORM_BUFFER_H
+#define TRANSFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "shaderClass.h"
+
+// GLSL declarations for reading the TransformBuffer, to insert after
+// #version in vertex shaders. An object's slot holds its model matrix and
+// the inverse transpose of its upper 3x3 for normals.
+inline constexpr const char* TRANSFORM_BUFFER_GLSL = R"(
+uniform samplerBuffer transforms;
+
+mat4 objectTransform(uint slot)
+{
+    int base = int(slot) * 7;
+    return mat4(texelFetch(transforms, base), texelFetch(transforms, base + 1),
+        texelFetch(transforms, base + 2), texelFetch(transforms, base + 3));
+}
+
+mat3 objectNormalMatrix(uint slot)
+{
+    int base = int(slot) * 7 + 4;
+    return mat3(texelFetch(transforms, base).xyz, texelFetch(transforms, base + 1).xyz,
+        texelFetch(transforms, base + 2).xyz);
+}
+)";
+
+// Model and normal matrices of every object, in one texture buffer that
+// shaders index with the object's slot. set() recomputes the normal matrix
+// and marks the slot dirty only when the transform actually changed, and
+// upload() sends the dirty range once per frame, so static objects cost
+// nothing after their first frame. Slot IDENTITY always holds the identity.
+class TransformBuffer {
+public:
+    static constexpr GLuint UNIT = 4;
+    static constexpr uint32_t IDENTITY = 0;
+
+    static TransformBuffer& instance() {
+        static TransformBuffer buffer;
+        return buffer;
+    }
+
+    uint32_t allocate() {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            slot = static_cast<uint32_t>(entries.size());
+            entries.emplace_back();
+            matrices.emplace_back(1.0f);
+        }
+        write(slot, glm::mat4(1.0f));
+        return slot;
+    }
+
+    void release(uint32_t slot) {
+        if (slot != IDENTITY)
+            freeSlots.push_back(slot);
+    }
+
+    void set(uint32_t slot, const glm::mat4& transform) {
+        if (slot != IDENTITY && matrices[slot] != transform)
+            write(slot, transform);
+    }
+
+    const glm::mat4& transform(uint32_t slot) const {
+        return matrices[slot];
+    }
+
+    // Slots the texture buffer can address: GL_MAX_TEXTURE_BUFFER_SIZE
+    // texels, only 65536 guaranteed by GL 3.3, over the texels per slot.
+    // Needs the context; the query is made once.
+    size_t maxSlots() {
+        if (slotLimit == 0) {
+            GLint texels = 0;
+            glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+            slotLimit = std::max<size_t>(1, static_cast<size_t>(std::max(texels, 65536)) / TEXELS_PER_SLOT);
+        }
+        return slotLimit;
+    }
+
+    // Sends the slots changed since the last call and binds the buffer to
+    // UNIT. Call once per frame before drawing. Slots past maxSlots() are
+    // not sent, so nothing placed by them may be drawn.
+    void upload() {
+        if (VBO == 0) {
+            glGenBuffers(1, &VBO);
+            glGenTextures(1, &texture);
+        }
+        updated = 0;
+        size_t needed = std::min(entries.size(), maxSlots());
+        if (entries.size() > needed && !overflowReported) {
+            std::cerr << "WARN: " << entries.size() << " transforms exceed the texture buffer limit of "
+                << needed << std::endl;
+            overflowReported = true;
+        }
+        dirtyEnd = std::min(dirtyEnd, needed);
+        if (capacity < needed) {
+            while (capacity < needed)
+                capacity = std::min(capacity == 0 ? 256 : capacity * 2, maxSlots());
+            glBindBuffer(GL_TEXTURE_BUFFER, VBO);
+            glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(Entry), nullptr, GL_DYNAMIC_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, VBO);
+            dirtyBegin = 0;
+            dirtyEnd = needed;
+        }
+        if (dirtyBegin < dirtyEnd) {
+            glBindBuffer(GL_TEXTURE_BUFFER, VBO);
+            glBufferSubData(GL_TEXTURE_BUFFER, dirtyBegin * sizeof(Entry), (dirtyEnd - dirtyBegin) * sizeof(Entry),
+                &entries[dirtyBegin]);
+            updated = static_cast<int>(dirtyEnd - dirtyBegin);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        dirtyBegin = SIZE_MAX;
+        dirtyEnd = 0;
+
+        glActiveTexture(GL_TEXTURE0 + UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    static void attach(const Shader& shader) {
+        static constexpr UniformName TRANSFORMS = "transforms";
+        shader.use();
+        shader.set(shader.uniform<int>(TRANSFORMS), static_cast<int>(UNIT));
+    }
+
+    size_t size() const {
+        return entries.size() - freeSlots.size();
+    }
+
+    // Slots sent by the last upload(), including clean ones inside the
+    // dirty range.
+    int lastUpdated() const {
+        return updated;
+    }
+
+private:
+    // Seven RGBA32F texels: the model matrix columns, then the normal
+    // matrix columns padded to vec4.
+    struct Entry {
+        glm::vec4 model[4];
+        glm::vec4 normal[3];
+    };
+    static constexpr size_t TEXELS_PER_SLOT = sizeof(Entry) / sizeof(glm::vec4);
+
+    std::vector<Entry> entries;
+    std::vector<glm::mat4> matrices;
+    std::vector<uint32_t> freeSlots;
+    size_t dirtyBegin = SIZE_MAX;
+    size_t dirtyEnd = 0;
+    size_t capacity = 0;
+    size_t slotLimit = 0;
+    bool overflowReported = false;
+    unsigned int VBO = 0;
+    unsigned int texture = 0;
+    int updated = 0;
+
+    TransformBuffer() {
+        allocate();
+    }
+
+    void write(uint32_t slot, const glm::mat4& transform) {
+        matrices[slot] = transform;
+        glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(transform)));
+        Entry& entry = entries[slot];
+        for (int i = 0; i < 4; i++)
+            entry.model[i] = transform[i];
+        for (int i = 0; i < 3; i++)
+            entry.normal[i] = glm::vec4(normal[i], 0.0f);
+        dirtyBegin = std::min<size_t>(dirtyBegin, slot);
+        dirtyEnd = std::max<size_t>(dirtyEnd, slot + 1);
+    }
+};
+
+// An object's slot in the TransformBuffer, released when destroyed.
+class TransformSlot {
+public:
+    TransformSlot() : slot(TransformBuffer::instance().allocate()) {
+    }
+
+    ~TransformSlot() {
+        if (owned)
+            TransformBuffer::instance().release(slot);
+    }
+
+    TransformSlot(TransformSlot&& other) noexcept : slot(other.slot), owned(other.owned) {
+        other.owned = false;
+    }
+
+    TransformSlot& operator=(TransformSlot&& other) noexcept {
+        if (this != &other) {
+            if (owned)
+                TransformBuffer::instance().release(slot);
+            slot = other.slot;
+            owned = other.owned;
+            other.owned = false;
+        }
+        return *this;
+    }
+
+    TransformSlot(const TransformSlot&) = delete;
+    TransformSlot& operator=(const TransformSlot&) = delete;
+
+    void set(const glm::mat4& transform) {
+        TransformBuffer::instance().set(slot, transform);
+    }
+
+    const glm::mat4& transform() const {
+        return TransformBuffer::instance().transform(slot);
+    }
+
+    uint32_t index() const {
+        return slot;
+    }
+
+private:
+    uint32_t slot;
+    bool owned = true;
+};
+
+#endif